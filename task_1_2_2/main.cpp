@@ -1,57 +1,326 @@
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstdio>
 #include <iostream>
-#include <limits>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
-struct tree_node {
-  int parent_id = -1;
+// Reader of whitespace separated tokens. The input is read in large blocks and
+// the tokens are parsed straight from the block, bypassing the iostream machinery
+class input_scanner {
+ public:
+  explicit input_scanner(std::FILE* file, size_t block_size = size_t{1} << 16)
+    : file_{file}
+    , block_(block_size)
+    , position_{0}
+    , size_{0}
+  {}
+
+  template <
+    typename Integer,
+    typename std::enable_if<std::is_integral<Integer>::value, int>::type = 0>
+  input_scanner& operator >> (Integer& value) {
+    skip_spaces();
+    const auto negative = (peek() == '-');
+    if (negative) {
+      ++position_;
+    }
+    auto result = Integer{0};
+    for (auto c = peek(); '0' <= c && c <= '9'; c = peek()) {
+      result = static_cast<Integer>(result * 10 + (c - '0'));
+      ++position_;
+    }
+    value = negative ? static_cast<Integer>(-result) : result;
+    return *this;
+  }
+
+  input_scanner& operator >> (char& value) {
+    skip_spaces();
+    const auto c = peek();
+    if (c != end_of_input) {
+      value = static_cast<char>(c);
+      ++position_;
+    }
+    return *this;
+  }
+
+  input_scanner& operator >> (std::string& value) {
+    skip_spaces();
+    value.clear();
+    while (peek() != end_of_input) {
+      auto last = position_;
+      while (last < size_ && !is_space(static_cast<unsigned char>(block_[last]))) {
+        ++last;
+      }
+      value.append(block_.data() + position_, last - position_);
+      position_ = last;
+      if (position_ < size_) {
+        break;
+      }
+    }
+    return *this;
+  }
+
+ private:
+  static constexpr int end_of_input = -1;
+
+  static bool is_space(int c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+  }
+
+  int peek() {
+    if (position_ == size_) {
+      size_ = std::fread(block_.data(), 1, block_.size(), file_);
+      position_ = 0;
+      if (size_ == 0) {
+        return end_of_input;
+      }
+    }
+    return static_cast<unsigned char>(block_[position_]);
+  }
+
+  void skip_spaces() {
+    while (is_space(peek())) {
+      ++position_;
+    }
+  }
+
+  std::FILE* file_;
+  std::vector<char> block_;
+  size_t position_;
+  size_t size_;
+};
+
+// tree given by the parent links of its nodes. The children are kept in compressed
+// sparse row form: the children of `node_id` are
+// children[child_offsets[node_id]], ..., children[child_offsets[node_id + 1] - 1]
+struct parent_array_tree {
+  std::vector<int> parents;
+  std::vector<int> child_offsets;
   std::vector<int> children;
 };
 
-int get_tree_root(const std::vector<tree_node>& tree) {
+// the child lists are built in three flat passes: count the children of every node,
+// turn the counts into list ends and put every child in front of its list end,
+// which leaves the ends pointing at the list starts
+parent_array_tree make_parent_array_tree(std::vector<int> parents) {
+  const auto nodes_count = parents.size();
+  auto child_offsets = std::vector<int>(nodes_count + 1);
+  auto children_count = int{0};
+  for (const auto& parent_id : parents) {
+    if (parent_id != -1) {
+      ++child_offsets[parent_id];
+      ++children_count;
+    }
+  }
+  for (auto node_id = size_t{1}; node_id < nodes_count; ++node_id) {
+    child_offsets[node_id] += child_offsets[node_id - 1];
+  }
+  child_offsets[nodes_count] = children_count;
+  auto children = std::vector<int>(children_count);
+  for (auto node_id = static_cast<int>(nodes_count) - 1; node_id >= 0; --node_id) {
+    const auto parent_id = parents[node_id];
+    if (parent_id != -1) {
+      children[--child_offsets[parent_id]] = node_id;
+    }
+  }
+  return parent_array_tree{std::move(parents), std::move(child_offsets), std::move(children)};
+}
+
+int get_tree_root(const parent_array_tree& tree) {
   auto root_id = int{0};
-  auto parent_id = tree[root_id].parent_id;
+  auto parent_id = tree.parents[root_id];
   while (parent_id != -1) {
     root_id = parent_id;
-    parent_id = tree[root_id].parent_id;
+    parent_id = tree.parents[root_id];
   }
   return root_id;
 }
 
-
-int get_tree_height_impl(int root_id, const std::vector<tree_node>& tree) {
-  assert(0 <= root_id && root_id < tree.size());
+// height of the tree walked level by level from the root over the child lists
+int get_tree_height_from_root(const parent_array_tree& tree) {
   auto height = int{0};
-  if (tree[root_id].children.empty()) {
-    height = 1;
-  } else {
-    auto max_subtree_height = std::numeric_limits<int>::min();
-    for (const auto& child_id : tree[root_id].children) {
-      max_subtree_height = std::max(
-        max_subtree_height, get_tree_height_impl(child_id, tree));
+  auto order = std::vector<int>{};
+  order.reserve(tree.parents.size());
+  order.push_back(get_tree_root(tree));
+  for (auto level_begin = size_t{0}; level_begin < order.size(); ++height) {
+    const auto level_end = order.size();
+    for (auto position = level_begin; position < level_end; ++position) {
+      const auto node_id = order[position];
+      order.insert(
+        order.end(),
+        tree.children.begin() + tree.child_offsets[node_id],
+        tree.children.begin() + tree.child_offsets[node_id + 1]);
     }
-    height = 1 + max_subtree_height;
+    level_begin = level_end;
   }
   return height;
 }
 
-int get_tree_height(const std::vector<tree_node>& tree) {
-  auto root_id = get_tree_root(tree);
-  return get_tree_height_impl(root_id, tree);
+// resolve the depths of the nodes in [first_id, last_id), the roots have depth 1 and
+// unknown depths are 0. Every node walks up to the closest ancestor with a known depth
+// and then fills in the depths on the way back, so a node is walked over only until
+// its depth is known. Returns the largest depth in the range
+int resolve_depths(
+    int first_id, int last_id,
+    const parent_array_tree& tree, std::vector<std::atomic<int>>& depths) {
+  auto max_depth = int{0};
+  auto path = std::vector<int>{};
+  for (auto node_id = first_id; node_id < last_id; ++node_id) {
+    auto depth = int{0};
+    for (auto ancestor_id = node_id; ancestor_id != -1; ancestor_id = tree.parents[ancestor_id]) {
+      depth = depths[ancestor_id].load(std::memory_order_relaxed);
+      if (depth != 0) {
+        break;
+      }
+      path.push_back(ancestor_id);
+    }
+    for (; !path.empty(); path.pop_back()) {
+      depths[path.back()].store(++depth, std::memory_order_relaxed);
+    }
+    max_depth = std::max(max_depth, depth);
+  }
+  return max_depth;
 }
 
+// height of the tree computed from the parent links alone in `threads_count` threads.
+// Each thread resolves the depths of its own range of nodes. Threads may race to fill
+// the same ancestors, but they always store the same depth there. A single thread
+// walks the child lists instead, which needs no depth per node
+int get_tree_height(const parent_array_tree& tree, size_t threads_count) {
+  constexpr auto min_nodes_per_thread = size_t{1} << 16;
+  const auto nodes_count = tree.parents.size();
+  threads_count = std::max(size_t{1}, std::min(threads_count, nodes_count / min_nodes_per_thread));
+  if (threads_count == 1) {
+    return nodes_count == 0 ? 0 : get_tree_height_from_root(tree);
+  }
+  auto depths = std::vector<std::atomic<int>>(nodes_count);
+  auto max_depths = std::vector<int>(threads_count);
+  auto threads = std::vector<std::thread>{};
+  for (auto thread_id = size_t{0}; thread_id < threads_count; ++thread_id) {
+    const auto first_id = static_cast<int>(nodes_count * thread_id / threads_count);
+    const auto last_id = static_cast<int>(nodes_count * (thread_id + 1) / threads_count);
+    threads.emplace_back([&tree, &depths, &max_depths, thread_id, first_id, last_id]() {
+      max_depths[thread_id] = resolve_depths(first_id, last_id, tree, depths);
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  return *std::max_element(max_depths.begin(), max_depths.end());
+}
 
-int main() {
-  auto nodes_count = int{0};
-  std::cin >> nodes_count;
-  auto tree = std::vector<tree_node>(nodes_count);
+int get_tree_height(const parent_array_tree& tree) {
+  return get_tree_height(tree, std::max(1u, std::thread::hardware_concurrency()));
+}
+
+// roots of all the trees of the forest in increasing order
+std::vector<int> get_forest_roots(const parent_array_tree& forest) {
+  auto roots = std::vector<int>{};
+  const auto nodes_count = static_cast<int>(forest.parents.size());
   for (auto node_id = int{0}; node_id < nodes_count; ++node_id) {
-    auto parent_id = int{0};
-    std::cin >> parent_id;
-    tree[node_id].parent_id = parent_id;
-    if (parent_id != -1) {
-      tree[parent_id].children.push_back(node_id);
+    if (forest.parents[node_id] == -1) {
+      roots.push_back(node_id);
+    }
+  }
+  return roots;
+}
+
+struct forest_statistics {
+  std::vector<int> roots;
+  // per node, the roots have depth 1
+  std::vector<int> depths;
+  // per node, the node itself included
+  std::vector<int> subtree_sizes;
+  // per root, in the order of `roots`
+  std::vector<int> heights;
+};
+
+// statistics of the tree of the `root_index`-th root. The tree is put in breadth
+// first order into `order`, the depths are set on the way down and the subtree sizes
+// are summed up on the way back over the same order
+void compute_tree_statistics(
+    size_t root_index, const parent_array_tree& forest,
+    std::vector<int>& order, forest_statistics& statistics) {
+  const auto root_id = statistics.roots[root_index];
+  order.clear();
+  order.push_back(root_id);
+  statistics.depths[root_id] = 1;
+  for (auto position = size_t{0}; position < order.size(); ++position) {
+    const auto node_id = order[position];
+    const auto child_depth = statistics.depths[node_id] + 1;
+    const auto first = forest.child_offsets[node_id];
+    const auto last = forest.child_offsets[node_id + 1];
+    for (auto offset = first; offset < last; ++offset) {
+      const auto child_id = forest.children[offset];
+      statistics.depths[child_id] = child_depth;
+      order.push_back(child_id);
+    }
+  }
+  statistics.heights[root_index] = statistics.depths[order.back()];
+  for (auto position = order.size() - 1; position > 0; --position) {
+    const auto node_id = order[position];
+    statistics.subtree_sizes[forest.parents[node_id]] += statistics.subtree_sizes[node_id];
+  }
+}
+
+// depths, subtree sizes and heights of all the trees of the forest in `threads_count`
+// threads. The threads take whole trees one by one, so no two threads ever write
+// the statistics of the same node
+forest_statistics compute_forest_statistics(
+    const parent_array_tree& forest, size_t threads_count) {
+  const auto nodes_count = forest.parents.size();
+  auto statistics = forest_statistics{};
+  statistics.roots = get_forest_roots(forest);
+  statistics.depths.assign(nodes_count, 0);
+  statistics.subtree_sizes.assign(nodes_count, 1);
+  statistics.heights.assign(statistics.roots.size(), 0);
+  auto next_root_index = std::atomic<size_t>{0};
+  auto compute = [&forest, &statistics, &next_root_index]() {
+    auto order = std::vector<int>{};
+    for (auto root_index = next_root_index++;
+         root_index < statistics.roots.size();
+         root_index = next_root_index++) {
+      compute_tree_statistics(root_index, forest, order, statistics);
+    }
+  };
+  threads_count = std::max(size_t{1}, std::min(threads_count, statistics.roots.size()));
+  auto threads = std::vector<std::thread>{};
+  for (auto thread_id = size_t{1}; thread_id < threads_count; ++thread_id) {
+    threads.emplace_back(compute);
+  }
+  compute();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  return statistics;
+}
+
+forest_statistics compute_forest_statistics(const parent_array_tree& forest) {
+  return compute_forest_statistics(forest, std::max(1u, std::thread::hardware_concurrency()));
+}
+
+// `--forest` reads a forest in the same format and prints every root with the height
+// of its tree, a root per line
+int main(int argc, char* argv[]) {
+  auto input = input_scanner{stdin};
+  auto nodes_count = int{0};
+  input >> nodes_count;
+  auto parents = std::vector<int>(nodes_count);
+  for (auto& parent_id : parents) {
+    input >> parent_id;
+  }
+  const auto tree = make_parent_array_tree(std::move(parents));
+  if (argc > 1 && std::string{argv[1]} == "--forest") {
+    const auto statistics = compute_forest_statistics(tree);
+    for (auto root_index = size_t{0}; root_index < statistics.roots.size(); ++root_index) {
+      std::cout << statistics.roots[root_index] << ' ' << statistics.heights[root_index] << '\n';
     }
+    return 0;
   }
   std::cout << get_tree_height(tree);
   return 0;
@@ -1,7 +1,222 @@
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
 #include <vector>
 
+// Reader of whitespace separated tokens. The input is read in large blocks and
+// the tokens are parsed straight from the block, bypassing the iostream machinery
+class input_scanner {
+ public:
+  explicit input_scanner(std::FILE* file, size_t block_size = size_t{1} << 16)
+    : file_{file}
+    , block_(block_size)
+    , position_{0}
+    , size_{0}
+  {}
+
+  template <
+    typename Integer,
+    typename std::enable_if<std::is_integral<Integer>::value, int>::type = 0>
+  input_scanner& operator >> (Integer& value) {
+    skip_spaces();
+    const auto negative = (peek() == '-');
+    if (negative) {
+      ++position_;
+    }
+    auto result = Integer{0};
+    for (auto c = peek(); '0' <= c && c <= '9'; c = peek()) {
+      result = static_cast<Integer>(result * 10 + (c - '0'));
+      ++position_;
+    }
+    value = negative ? static_cast<Integer>(-result) : result;
+    return *this;
+  }
+
+  input_scanner& operator >> (char& value) {
+    skip_spaces();
+    const auto c = peek();
+    if (c != end_of_input) {
+      value = static_cast<char>(c);
+      ++position_;
+    }
+    return *this;
+  }
+
+  input_scanner& operator >> (std::string& value) {
+    skip_spaces();
+    value.clear();
+    while (peek() != end_of_input) {
+      auto last = position_;
+      while (last < size_ && !is_space(static_cast<unsigned char>(block_[last]))) {
+        ++last;
+      }
+      value.append(block_.data() + position_, last - position_);
+      position_ = last;
+      if (position_ < size_) {
+        break;
+      }
+    }
+    return *this;
+  }
+
+  // next byte of the input without consuming it, -1 at the end of the input
+  int next_byte() {
+    return peek();
+  }
+
+  // read the object representation of `value` as it is, without parsing
+  template <typename T>
+  input_scanner& read_binary(T& value) {
+    static_assert(std::is_trivially_copyable<T>::value, "value must be trivially copyable");
+    return read_bytes(reinterpret_cast<char*>(std::addressof(value)), sizeof(T));
+  }
+
+  // read next `count` bytes of the input as they are
+  input_scanner& read_bytes(char* data, size_t count) {
+    while (count > 0 && peek() != end_of_input) {
+      const auto chunk = std::min(count, size_ - position_);
+      std::memcpy(data, block_.data() + position_, chunk);
+      position_ += chunk;
+      data += chunk;
+      count -= chunk;
+    }
+    return *this;
+  }
+
+ private:
+  static constexpr int end_of_input = -1;
+
+  static bool is_space(int c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+  }
+
+  int peek() {
+    if (position_ == size_) {
+      size_ = std::fread(block_.data(), 1, block_.size(), file_);
+      position_ = 0;
+      if (size_ == 0) {
+        return end_of_input;
+      }
+    }
+    return static_cast<unsigned char>(block_[position_]);
+  }
+
+  void skip_spaces() {
+    while (is_space(peek())) {
+      ++position_;
+    }
+  }
+
+  std::FILE* file_;
+  std::vector<char> block_;
+  size_t position_;
+  size_t size_;
+};
+
+// Writer of text output. The text is gathered in a large block which is written out
+// when it is full, on `flush` and on destruction. Integers are formatted by hand
+class output_printer {
+ public:
+  explicit output_printer(std::FILE* file, size_t block_size = size_t{1} << 16)
+    : file_{file}
+    , block_(block_size)
+    , size_{0}
+  {}
+
+  output_printer(const output_printer&) = delete;
+  output_printer& operator = (const output_printer&) = delete;
+
+  ~output_printer() {
+    flush();
+  }
+
+  template <
+    typename Integer,
+    typename std::enable_if<std::is_integral<Integer>::value, int>::type = 0>
+  output_printer& operator << (Integer value) {
+    using unsigned_type = typename std::make_unsigned<Integer>::type;
+    // room for the sign and all the digits
+    reserve(std::numeric_limits<unsigned_type>::digits10 + 2);
+    auto magnitude = static_cast<unsigned_type>(value);
+    if (value < Integer{0}) {
+      block_[size_++] = '-';
+      magnitude = unsigned_type{0} - magnitude;
+    }
+    char digits[std::numeric_limits<unsigned_type>::digits10 + 1];
+    auto count = size_t{0};
+    do {
+      digits[count++] = static_cast<char>('0' + magnitude % 10);
+      magnitude /= 10;
+    } while (magnitude != 0);
+    while (count > 0) {
+      block_[size_++] = digits[--count];
+    }
+    return *this;
+  }
+
+  output_printer& operator << (char value) {
+    reserve(1);
+    block_[size_++] = value;
+    return *this;
+  }
+
+  output_printer& operator << (const char* text) {
+    write(text, std::strlen(text));
+    return *this;
+  }
+
+  output_printer& operator << (const std::string& text) {
+    write(text.data(), text.size());
+    return *this;
+  }
+
+  // write the object representation of `value` as it is, without formatting
+  template <typename T>
+  output_printer& write_binary(const T& value) {
+    static_assert(std::is_trivially_copyable<T>::value, "value must be trivially copyable");
+    write(reinterpret_cast<const char*>(std::addressof(value)), sizeof(T));
+    return *this;
+  }
+
+  // write out everything printed so far
+  void flush() {
+    drain();
+    std::fflush(file_);
+  }
+
+ private:
+  void drain() {
+    std::fwrite(block_.data(), 1, size_, file_);
+    size_ = 0;
+  }
+
+  void reserve(size_t count) {
+    if (block_.size() - size_ < count) {
+      drain();
+    }
+  }
+
+  void write(const char* data, size_t count) {
+    reserve(count);
+    if (count > block_.size()) {
+      std::fwrite(data, 1, count, file_);
+      return;
+    }
+    std::memcpy(block_.data() + size_, data, count);
+    size_ += count;
+  }
+
+  std::FILE* file_;
+  std::vector<char> block_;
+  size_t size_;
+};
+
 // Max stack
 template <typename T, typename Comparator = std::less<T>>
 class priority_stack {
@@ -62,25 +277,122 @@ class priority_stack {
   Comparator comp_;
 };
 
-int main() {
-  std::ios_base::sync_with_stdio(false);
-  auto stck = priority_stack<int, std::less<int>>{};
-  auto queries_count = size_t{0};
-  std::cin >> queries_count;
-  for (auto query_id = size_t{0}; query_id < queries_count; ++query_id) {
-    auto command = std::string{};
-    std::cin >> command;
-    if (command == "push") {
-      auto value = int{0};
-      std::cin >> value;
-      stck.push(value);
-    } else if (command == "pop") {
-      stck.pop();
-    } else if (command == "max") {
-      std::cout << stck.top_priority() << '\n';
+enum class stack_request_type : uint8_t {
+  push,
+  pop,
+  max
+};
+
+struct stack_request {
+  stack_request_type type;
+  int32_t value;
+};
+
+// Requests come as text or in the binary format. The binary format is the marker
+// byte, the requests count as uint64_t and the requests, every request is the type
+// byte, `push` is followed by its int32_t value. Numbers are in the byte order
+// of the machine
+constexpr auto binary_requests_marker = 0xB1;
+
+// Stream of requests, every request is parsed only when it is asked for
+class stack_request_reader {
+ public:
+  explicit stack_request_reader(input_scanner& in)
+    : in_{in}
+    , requests_left_{0}
+    , binary_{in.next_byte() == binary_requests_marker}
+  {
+    if (binary_) {
+      auto marker = uint8_t{0};
+      auto count = uint64_t{0};
+      in_.read_binary(marker).read_binary(count);
+      requests_left_ = count;
+    } else {
+      in_ >> requests_left_;
+    }
+  }
+
+  // number of requests which are not read yet
+  size_t size() const {
+    return requests_left_;
+  }
+
+  // parse next request into `request`, false when the requests are over
+  bool next(stack_request& request) {
+    if (requests_left_ == 0) {
+      return false;
+    }
+    --requests_left_;
+    if (binary_) {
+      in_.read_binary(request.type);
+      if (request.type == stack_request_type::push) {
+        in_.read_binary(request.value);
+      }
+      return true;
+    }
+    in_ >> command_;
+    if (command_ == "push") {
+      request.type = stack_request_type::push;
+      in_ >> request.value;
+    } else if (command_ == "pop") {
+      request.type = stack_request_type::pop;
+    } else if (command_ == "max") {
+      request.type = stack_request_type::max;
     } else {
       assert(false);
     }
+    return true;
+  }
+
+ private:
+  input_scanner& in_;
+  size_t requests_left_;
+  bool binary_;
+  std::string command_;
+};
+
+// convert requests to the binary format
+void encode_requests(stack_request_reader& reader, output_printer& out) {
+  out.write_binary(static_cast<uint8_t>(binary_requests_marker));
+  out.write_binary(static_cast<uint64_t>(reader.size()));
+  auto request = stack_request{};
+  while (reader.next(request)) {
+    out.write_binary(request.type);
+    if (request.type == stack_request_type::push) {
+      out.write_binary(request.value);
+    }
+  }
+}
+
+int main(int argc, char* argv[]) {
+  auto input = input_scanner{stdin};
+  auto output = output_printer{stdout};
+  auto reader = stack_request_reader{input};
+  if (argc > 1 && std::string{argv[1]} == "--encode") {
+    encode_requests(reader, output);
+    return 0;
+  }
+  auto stck = priority_stack<int, std::less<int>>{};
+  auto request = stack_request{};
+  while (reader.next(request)) {
+    switch (request.type) {
+      case stack_request_type::push: {
+        stck.push(request.value);
+        break;
+      }
+      case stack_request_type::pop: {
+        stck.pop();
+        break;
+      }
+      case stack_request_type::max: {
+        output << stck.top_priority() << '\n';
+        break;
+      }
+      default : {
+        assert(false);
+        break;
+      }
+    }
   }
   return 0;
 }
\ No newline at end of file
@@ -1,8 +1,189 @@
 #include <cassert>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <string>
+#include <type_traits>
 #include <vector>
 #include <queue>
 
+// Reader of whitespace separated tokens. The input is read in large blocks and
+// the tokens are parsed straight from the block, bypassing the iostream machinery
+class input_scanner {
+ public:
+  explicit input_scanner(std::FILE* file, size_t block_size = size_t{1} << 16)
+    : file_{file}
+    , block_(block_size)
+    , position_{0}
+    , size_{0}
+  {}
+
+  template <
+    typename Integer,
+    typename std::enable_if<std::is_integral<Integer>::value, int>::type = 0>
+  input_scanner& operator >> (Integer& value) {
+    skip_spaces();
+    const auto negative = (peek() == '-');
+    if (negative) {
+      ++position_;
+    }
+    auto result = Integer{0};
+    for (auto c = peek(); '0' <= c && c <= '9'; c = peek()) {
+      result = static_cast<Integer>(result * 10 + (c - '0'));
+      ++position_;
+    }
+    value = negative ? static_cast<Integer>(-result) : result;
+    return *this;
+  }
+
+  input_scanner& operator >> (char& value) {
+    skip_spaces();
+    const auto c = peek();
+    if (c != end_of_input) {
+      value = static_cast<char>(c);
+      ++position_;
+    }
+    return *this;
+  }
+
+  input_scanner& operator >> (std::string& value) {
+    skip_spaces();
+    value.clear();
+    while (peek() != end_of_input) {
+      auto last = position_;
+      while (last < size_ && !is_space(static_cast<unsigned char>(block_[last]))) {
+        ++last;
+      }
+      value.append(block_.data() + position_, last - position_);
+      position_ = last;
+      if (position_ < size_) {
+        break;
+      }
+    }
+    return *this;
+  }
+
+ private:
+  static constexpr int end_of_input = -1;
+
+  static bool is_space(int c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+  }
+
+  int peek() {
+    if (position_ == size_) {
+      size_ = std::fread(block_.data(), 1, block_.size(), file_);
+      position_ = 0;
+      if (size_ == 0) {
+        return end_of_input;
+      }
+    }
+    return static_cast<unsigned char>(block_[position_]);
+  }
+
+  void skip_spaces() {
+    while (is_space(peek())) {
+      ++position_;
+    }
+  }
+
+  std::FILE* file_;
+  std::vector<char> block_;
+  size_t position_;
+  size_t size_;
+};
+
+// Writer of text output. The text is gathered in a large block which is written out
+// when it is full, on `flush` and on destruction. Integers are formatted by hand
+class output_printer {
+ public:
+  explicit output_printer(std::FILE* file, size_t block_size = size_t{1} << 16)
+    : file_{file}
+    , block_(block_size)
+    , size_{0}
+  {}
+
+  output_printer(const output_printer&) = delete;
+  output_printer& operator = (const output_printer&) = delete;
+
+  ~output_printer() {
+    flush();
+  }
+
+  template <
+    typename Integer,
+    typename std::enable_if<std::is_integral<Integer>::value, int>::type = 0>
+  output_printer& operator << (Integer value) {
+    using unsigned_type = typename std::make_unsigned<Integer>::type;
+    // room for the sign and all the digits
+    reserve(std::numeric_limits<unsigned_type>::digits10 + 2);
+    auto magnitude = static_cast<unsigned_type>(value);
+    if (value < Integer{0}) {
+      block_[size_++] = '-';
+      magnitude = unsigned_type{0} - magnitude;
+    }
+    char digits[std::numeric_limits<unsigned_type>::digits10 + 1];
+    auto count = size_t{0};
+    do {
+      digits[count++] = static_cast<char>('0' + magnitude % 10);
+      magnitude /= 10;
+    } while (magnitude != 0);
+    while (count > 0) {
+      block_[size_++] = digits[--count];
+    }
+    return *this;
+  }
+
+  output_printer& operator << (char value) {
+    reserve(1);
+    block_[size_++] = value;
+    return *this;
+  }
+
+  output_printer& operator << (const char* text) {
+    write(text, std::strlen(text));
+    return *this;
+  }
+
+  output_printer& operator << (const std::string& text) {
+    write(text.data(), text.size());
+    return *this;
+  }
+
+  // write out everything printed so far
+  void flush() {
+    drain();
+    std::fflush(file_);
+  }
+
+ private:
+  void drain() {
+    std::fwrite(block_.data(), 1, size_, file_);
+    size_ = 0;
+  }
+
+  void reserve(size_t count) {
+    if (block_.size() - size_ < count) {
+      drain();
+    }
+  }
+
+  void write(const char* data, size_t count) {
+    reserve(count);
+    if (count > block_.size()) {
+      std::fwrite(data, 1, count, file_);
+      return;
+    }
+    std::memcpy(block_.data() + size_, data, count);
+    size_ += count;
+  }
+
+  std::FILE* file_;
+  std::vector<char> block_;
+  size_t size_;
+};
+
 struct processor_info {
   size_t finish_time;
   size_t processor_id;
@@ -19,15 +200,17 @@ bool operator < (const processor_info& lhs, const processor_info& rhs) {
 }
 
 int main() {
+  auto input = input_scanner{stdin};
+  auto output = output_printer{stdout};
   auto processor_count = size_t{0};
-  std::cin >> processor_count;
+  input >> processor_count;
   auto tasks_count = size_t{0};
-  std::cin >> tasks_count;
+  input >> tasks_count;
   auto durations = std::vector<size_t>{};
   durations.reserve(tasks_count);
   for (auto task_id = size_t{0}; task_id < tasks_count; ++task_id) {
     auto task_duration = size_t{0};
-    std::cin >> task_duration;
+    input >> task_duration;
     durations.emplace_back(task_duration);
   }
   auto processors_queue = std::priority_queue<processor_info>{};
@@ -45,7 +228,7 @@ int main() {
       processor_info{free_processor.finish_time + durations[task_id], free_processor.processor_id});
   }
   for (const auto& report : reports) {
-    std::cout << report.processor_id << ' ' << report.start_time << '\n';
+    output << report.processor_id << ' ' << report.start_time << '\n';
   }
   return 0;
 }
\ No newline at end of file
@@ -1,8 +1,97 @@
 #include <algorithm>
 #include <cassert>
+#include <cstdio>
 #include <iostream>
+#include <string>
+#include <type_traits>
 #include <vector>
 
+// Reader of whitespace separated tokens. The input is read in large blocks and
+// the tokens are parsed straight from the block, bypassing the iostream machinery
+class input_scanner {
+ public:
+  explicit input_scanner(std::FILE* file, size_t block_size = size_t{1} << 16)
+    : file_{file}
+    , block_(block_size)
+    , position_{0}
+    , size_{0}
+  {}
+
+  template <
+    typename Integer,
+    typename std::enable_if<std::is_integral<Integer>::value, int>::type = 0>
+  input_scanner& operator >> (Integer& value) {
+    skip_spaces();
+    const auto negative = (peek() == '-');
+    if (negative) {
+      ++position_;
+    }
+    auto result = Integer{0};
+    for (auto c = peek(); '0' <= c && c <= '9'; c = peek()) {
+      result = static_cast<Integer>(result * 10 + (c - '0'));
+      ++position_;
+    }
+    value = negative ? static_cast<Integer>(-result) : result;
+    return *this;
+  }
+
+  input_scanner& operator >> (char& value) {
+    skip_spaces();
+    const auto c = peek();
+    if (c != end_of_input) {
+      value = static_cast<char>(c);
+      ++position_;
+    }
+    return *this;
+  }
+
+  input_scanner& operator >> (std::string& value) {
+    skip_spaces();
+    value.clear();
+    while (peek() != end_of_input) {
+      auto last = position_;
+      while (last < size_ && !is_space(static_cast<unsigned char>(block_[last]))) {
+        ++last;
+      }
+      value.append(block_.data() + position_, last - position_);
+      position_ = last;
+      if (position_ < size_) {
+        break;
+      }
+    }
+    return *this;
+  }
+
+ private:
+  static constexpr int end_of_input = -1;
+
+  static bool is_space(int c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+  }
+
+  int peek() {
+    if (position_ == size_) {
+      size_ = std::fread(block_.data(), 1, block_.size(), file_);
+      position_ = 0;
+      if (size_ == 0) {
+        return end_of_input;
+      }
+    }
+    return static_cast<unsigned char>(block_[position_]);
+  }
+
+  void skip_spaces() {
+    while (is_space(peek())) {
+      ++position_;
+    }
+  }
+
+  std::FILE* file_;
+  std::vector<char> block_;
+  size_t position_;
+  size_t size_;
+};
+
 class disjoint_set_union {
  public:
   disjoint_set_union()
@@ -64,30 +153,31 @@ class disjoint_set_union {
 };
 
 int main() {
+  auto input = input_scanner{stdin};
   auto variables_count = size_t{0};
-  std::cin >> variables_count;
+  input >> variables_count;
   auto equalities_count = size_t{0};
-  std::cin >> equalities_count;
+  input >> equalities_count;
   auto disequalities_count = size_t{0};
-  std::cin >> disequalities_count;
+  input >> disequalities_count;
   auto dsu = disjoint_set_union{};
   dsu.init(variables_count);
   for (auto equality_id = size_t{0}; equality_id < equalities_count; ++equality_id) {
     auto element_a_no = size_t{0};
-    std::cin >> element_a_no;
+    input >> element_a_no;
     assert(1 <= element_a_no && element_a_no <= dsu.size());
     auto element_b_no = size_t{0};
-    std::cin >> element_b_no;
+    input >> element_b_no;
     assert(1 <= element_b_no && element_b_no <= dsu.size());
     dsu.union_sets(element_a_no - 1, element_b_no - 1);
   }
   auto consistent = size_t{1};
   for (auto disequality_id = size_t{0}; disequality_id < disequalities_count; ++disequality_id) {
     auto element_a_no = size_t{0};
-    std::cin >> element_a_no;
+    input >> element_a_no;
     assert(1 <= element_a_no && element_a_no <= dsu.size());
     auto element_b_no = size_t{0};
-    std::cin >> element_b_no;
+    input >> element_b_no;
     assert(1 <= element_b_no && element_b_no <= dsu.size());
     if (dsu.find_set(element_a_no - 1) == dsu.find_set(element_b_no -1)) {
       consistent = 0;
@@ -1,39 +1,680 @@
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
+#include <vector>
 
+// Reader of whitespace separated tokens. The input is read in large blocks and
+// the tokens are parsed straight from the block, bypassing the iostream machinery
+class input_scanner {
+ public:
+  explicit input_scanner(std::FILE* file, size_t block_size = size_t{1} << 16)
+    : file_{file}
+    , block_(block_size)
+    , position_{0}
+    , size_{0}
+    , good_{true}
+  {}
 
-int main() {
-  auto requests_count = size_t{0};
-  std::cin >> requests_count;
-  auto phonebook = std::unordered_map<size_t, std::string>{};
-  for (auto request_id = size_t{0}; request_id < requests_count; ++request_id) {
-    auto command = std::string{};
-    std::cin >> command;
-    if (command == "add") {
-      auto number = size_t{0};
-      std::cin >> number;
-      auto name = std::string{};
-      std::cin >> name;
-      phonebook[number] = name;
-    } else if (command == "del") {
-      auto number = size_t{0};
-      std::cin >> number;
-      phonebook.erase(number);
-    } else if (command == "find") {
-      auto number = size_t{0};
-      std::cin >> number;
-      auto it = phonebook.find(number);
-      if (it != phonebook.end()) {
-        std::cout << it->second << '\n';
-      } else {
-        std::cout << "not found\n";
+  template <
+    typename Integer,
+    typename std::enable_if<std::is_integral<Integer>::value, int>::type = 0>
+  input_scanner& operator >> (Integer& value) {
+    skip_spaces();
+    const auto negative = (peek() == '-');
+    if (negative) {
+      ++position_;
+    }
+    auto result = Integer{0};
+    for (auto c = peek(); '0' <= c && c <= '9'; c = peek()) {
+      result = static_cast<Integer>(result * 10 + (c - '0'));
+      ++position_;
+    }
+    value = negative ? static_cast<Integer>(-result) : result;
+    return *this;
+  }
+
+  input_scanner& operator >> (char& value) {
+    skip_spaces();
+    const auto c = peek();
+    if (c != end_of_input) {
+      value = static_cast<char>(c);
+      ++position_;
+    }
+    return *this;
+  }
+
+  input_scanner& operator >> (std::string& value) {
+    skip_spaces();
+    value.clear();
+    while (peek() != end_of_input) {
+      auto last = position_;
+      while (last < size_ && !is_space(static_cast<unsigned char>(block_[last]))) {
+        ++last;
       }
+      value.append(block_.data() + position_, last - position_);
+      position_ = last;
+      if (position_ < size_) {
+        break;
+      }
+    }
+    return *this;
+  }
+
+  // next byte of the input without consuming it, -1 at the end of the input
+  int next_byte() {
+    return peek();
+  }
+
+  // read the object representation of `value` as it is, without parsing
+  template <typename T>
+  input_scanner& read_binary(T& value) {
+    static_assert(std::is_trivially_copyable<T>::value, "value must be trivially copyable");
+    return read_bytes(reinterpret_cast<char*>(std::addressof(value)), sizeof(T));
+  }
+
+  // read next `count` bytes of the input as they are
+  input_scanner& read_bytes(char* data, size_t count) {
+    while (count > 0 && peek() != end_of_input) {
+      const auto chunk = std::min(count, size_ - position_);
+      std::memcpy(data, block_.data() + position_, chunk);
+      position_ += chunk;
+      data += chunk;
+      count -= chunk;
+    }
+    if (count > 0) {
+      good_ = false;
+    }
+    return *this;
+  }
+
+  // false once the input ended in the middle of a binary read
+  bool good() const {
+    return good_;
+  }
+
+ private:
+  static constexpr int end_of_input = -1;
+
+  static bool is_space(int c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+  }
+
+  int peek() {
+    if (position_ == size_) {
+      size_ = std::fread(block_.data(), 1, block_.size(), file_);
+      position_ = 0;
+      if (size_ == 0) {
+        return end_of_input;
+      }
+    }
+    return static_cast<unsigned char>(block_[position_]);
+  }
+
+  void skip_spaces() {
+    while (is_space(peek())) {
+      ++position_;
+    }
+  }
+
+  std::FILE* file_;
+  std::vector<char> block_;
+  size_t position_;
+  size_t size_;
+  bool good_;
+};
+
+// Writer of text output. The text is gathered in a large block which is written out
+// when it is full, on `flush` and on destruction. Integers are formatted by hand
+class output_printer {
+ public:
+  explicit output_printer(std::FILE* file, size_t block_size = size_t{1} << 16)
+    : file_{file}
+    , block_(block_size)
+    , size_{0}
+  {}
+
+  output_printer(const output_printer&) = delete;
+  output_printer& operator = (const output_printer&) = delete;
+
+  ~output_printer() {
+    flush();
+  }
+
+  template <
+    typename Integer,
+    typename std::enable_if<std::is_integral<Integer>::value, int>::type = 0>
+  output_printer& operator << (Integer value) {
+    using unsigned_type = typename std::make_unsigned<Integer>::type;
+    // room for the sign and all the digits
+    reserve(std::numeric_limits<unsigned_type>::digits10 + 2);
+    auto magnitude = static_cast<unsigned_type>(value);
+    if (value < Integer{0}) {
+      block_[size_++] = '-';
+      magnitude = unsigned_type{0} - magnitude;
+    }
+    char digits[std::numeric_limits<unsigned_type>::digits10 + 1];
+    auto count = size_t{0};
+    do {
+      digits[count++] = static_cast<char>('0' + magnitude % 10);
+      magnitude /= 10;
+    } while (magnitude != 0);
+    while (count > 0) {
+      block_[size_++] = digits[--count];
+    }
+    return *this;
+  }
+
+  output_printer& operator << (char value) {
+    reserve(1);
+    block_[size_++] = value;
+    return *this;
+  }
+
+  output_printer& operator << (const char* text) {
+    write(text, std::strlen(text));
+    return *this;
+  }
+
+  output_printer& operator << (const std::string& text) {
+    write(text.data(), text.size());
+    return *this;
+  }
+
+  output_printer& operator << (std::string_view text) {
+    write(text.data(), text.size());
+    return *this;
+  }
+
+  // write the object representation of `value` as it is, without formatting
+  template <typename T>
+  output_printer& write_binary(const T& value) {
+    static_assert(std::is_trivially_copyable<T>::value, "value must be trivially copyable");
+    write(reinterpret_cast<const char*>(std::addressof(value)), sizeof(T));
+    return *this;
+  }
+
+  // write out everything printed so far
+  void flush() {
+    drain();
+    std::fflush(file_);
+  }
+
+ private:
+  void drain() {
+    std::fwrite(block_.data(), 1, size_, file_);
+    size_ = 0;
+  }
+
+  void reserve(size_t count) {
+    if (block_.size() - size_ < count) {
+      drain();
+    }
+  }
+
+  void write(const char* data, size_t count) {
+    reserve(count);
+    if (count > block_.size()) {
+      std::fwrite(data, 1, count, file_);
+      return;
+    }
+    std::memcpy(block_.data() + size_, data, count);
+    size_ += count;
+  }
+
+  std::FILE* file_;
+  std::vector<char> block_;
+  size_t size_;
+};
+
+
+// Phonebook over `std::unordered_map`, numbers may be arbitrary
+class hashed_phonebook {
+ public:
+  void insert(uint64_t number, const std::string& name) {
+    names_[number] = name;
+  }
+
+  void erase(uint64_t number) {
+    names_.erase(number);
+  }
+
+  // name of the number, empty if the number is not in the phonebook
+  std::string_view find(uint64_t number) const {
+    auto it = names_.find(number);
+    return it != names_.end() ? std::string_view{it->second} : std::string_view{};
+  }
+
+  bool empty() const {
+    return names_.empty();
+  }
+
+ private:
+  std::unordered_map<uint64_t, std::string> names_;
+};
+
+// Phonebook for numbers below a known bound. The entry of a number is found right by
+// the number: the entries are kept in pages which are allocated only when a number of
+// theirs is added, so sparse numbers cost little. The names are stored one after
+// another in a single arena. A new name of a number takes the place of the old one if
+// it fits there, the space left by the other names is reclaimed by packing the arena
+// once it is more than half garbage. Numbers out of the bound, names too long for an
+// entry and names which do not fit in the arena are kept in a hashed phonebook on the
+// side
+class direct_phonebook {
+ public:
+  explicit direct_phonebook(uint64_t number_bound)
+    : number_bound_{number_bound}
+    , pages_((number_bound + page_size - 1) / page_size)
+    , names_{}
+    , garbage_{0}
+    , others_{}
+  {}
+
+  void insert(uint64_t number, const std::string& name) {
+    if (number >= number_bound_ || name.size() > std::numeric_limits<uint8_t>::max()) {
+      erase_entry(number);
+      others_.insert(number, name);
+      return;
+    }
+    if (!others_.empty()) {
+      others_.erase(number);
+    }
+    auto& page = pages_[number / page_size];
+    if (!page) {
+      page.reset(new entry[page_size]);
+    }
+    auto& item = page[number % page_size];
+    if (item.is_present && name.size() <= item.name_capacity) {
+      std::memcpy(names_.data() + item.name_offset, name.data(), name.size());
+      item.name_length = static_cast<uint8_t>(name.size());
+      return;
+    }
+    if (names_.size() + name.size() > std::numeric_limits<uint32_t>::max()) {
+      // entries address the arena by 32-bit offsets, names past them go to the side
+      erase_entry(number);
+      others_.insert(number, name);
+      return;
+    }
+    if (item.is_present) {
+      garbage_ += item.name_capacity;
+    }
+    item.name_offset = static_cast<uint32_t>(names_.size());
+    item.name_length = static_cast<uint8_t>(name.size());
+    item.name_capacity = item.name_length;
+    item.is_present = true;
+    names_.insert(names_.end(), name.begin(), name.end());
+    pack_names();
+  }
+
+  void erase(uint64_t number) {
+    erase_entry(number);
+    if (!others_.empty()) {
+      others_.erase(number);
+    }
+  }
+
+  // name of the number, empty if the number is not in the phonebook
+  std::string_view find(uint64_t number) const {
+    if (number < number_bound_) {
+      const auto& page = pages_[number / page_size];
+      if (page && page[number % page_size].is_present) {
+        const auto& item = page[number % page_size];
+        return std::string_view{names_.data() + item.name_offset, item.name_length};
+      }
+    }
+    return !others_.empty() ? others_.find(number) : std::string_view{};
+  }
+
+ private:
+  struct entry {
+    uint32_t name_offset = 0;
+    uint8_t name_length = 0;
+    uint8_t name_capacity = 0;
+    bool is_present = false;
+  };
+
+  static constexpr auto page_size = uint64_t{4096};
+
+  void erase_entry(uint64_t number) {
+    if (number >= number_bound_) {
+      return;
+    }
+    auto& page = pages_[number / page_size];
+    if (page && page[number % page_size].is_present) {
+      auto& item = page[number % page_size];
+      item.is_present = false;
+      garbage_ += item.name_capacity;
+      pack_names();
+    }
+  }
+
+  void pack_names() {
+    if (garbage_ <= names_.size() / 2) {
+      return;
+    }
+    auto packed_names = std::vector<char>{};
+    packed_names.reserve(names_.size() - garbage_);
+    for (auto& page : pages_) {
+      if (!page) {
+        continue;
+      }
+      for (auto i = uint64_t{0}; i < page_size; ++i) {
+        auto& item = page[i];
+        if (item.is_present) {
+          const auto first = names_.begin() + item.name_offset;
+          item.name_offset = static_cast<uint32_t>(packed_names.size());
+          item.name_capacity = item.name_length;
+          packed_names.insert(packed_names.end(), first, first + item.name_length);
+        }
+      }
+    }
+    names_.swap(packed_names);
+    garbage_ = 0;
+  }
+
+ private:
+  uint64_t number_bound_;
+  std::vector<std::unique_ptr<entry[]>> pages_;
+  std::vector<char> names_;
+  size_t garbage_;
+  hashed_phonebook others_;
+};
+
+enum class phonebook_request_type : uint8_t {
+  add,
+  del,
+  find
+};
+
+struct phonebook_request {
+  phonebook_request_type type;
+  uint64_t number;
+  std::string name;
+};
+
+// Requests come as text or in the binary format. The binary format is the marker
+// byte, the requests count as uint64_t and the requests, every request is the type
+// byte and the uint64_t number, `add` is followed by the uint32_t length of the name
+// and the name itself. Numbers are in the byte order of the machine
+constexpr auto binary_requests_marker = 0xB1;
+
+// requests which can be neither served nor encoded stop the program in any build
+[[noreturn]] void reject_requests(const char* reason) {
+  std::fprintf(stderr, "phonebook requests: %s\n", reason);
+  std::exit(EXIT_FAILURE);
+}
+
+// Stream of requests, every request is parsed only when it is asked for
+class phonebook_request_reader {
+ public:
+  explicit phonebook_request_reader(input_scanner& in)
+    : in_{in}
+    , requests_left_{0}
+    , binary_{in.next_byte() == binary_requests_marker}
+  {
+    if (binary_) {
+      auto marker = uint8_t{0};
+      auto count = uint64_t{0};
+      in_.read_binary(marker).read_binary(count);
+      requests_left_ = count;
+    } else {
+      in_ >> requests_left_;
+    }
+  }
+
+  // number of requests which are not read yet
+  size_t size() const {
+    return requests_left_;
+  }
+
+  // parse next request into `request`, false when the requests are over
+  bool next(phonebook_request& request) {
+    if (requests_left_ == 0) {
+      return false;
+    }
+    --requests_left_;
+    if (binary_) {
+      in_.read_binary(request.type).read_binary(request.number);
+      if (request.type > phonebook_request_type::find) {
+        reject_requests("unknown request type");
+      }
+      if (request.type == phonebook_request_type::add) {
+        auto length = uint32_t{0};
+        in_.read_binary(length);
+        request.name.resize(length);
+        in_.read_bytes(&request.name[0], length);
+      }
+      if (!in_.good()) {
+        reject_requests("binary requests end in the middle of a request");
+      }
+      return true;
+    }
+    in_ >> command_;
+    if (command_ == "add") {
+      request.type = phonebook_request_type::add;
+      in_ >> request.number >> request.name;
+    } else if (command_ == "del") {
+      request.type = phonebook_request_type::del;
+      in_ >> request.number;
+    } else if (command_ == "find") {
+      request.type = phonebook_request_type::find;
+      in_ >> request.number;
     } else {
       assert(false);
     }
+    return true;
+  }
+
+ private:
+  input_scanner& in_;
+  size_t requests_left_;
+  bool binary_;
+  std::string command_;
+};
+
+// convert requests to the binary format
+void encode_requests(phonebook_request_reader& reader, output_printer& out) {
+  out.write_binary(static_cast<uint8_t>(binary_requests_marker));
+  out.write_binary(static_cast<uint64_t>(reader.size()));
+  auto request = phonebook_request{};
+  while (reader.next(request)) {
+    out.write_binary(request.type).write_binary(request.number);
+    if (request.type == phonebook_request_type::add) {
+      if (request.name.size() > std::numeric_limits<uint32_t>::max()) {
+        reject_requests("name is too long for the binary format");
+      }
+      out.write_binary(static_cast<uint32_t>(request.name.size()));
+      out << request.name;
+    }
+  }
+}
+
+template <typename Phonebook>
+void serve_requests(phonebook_request_reader& reader, Phonebook& phonebook, output_printer& out) {
+  auto request = phonebook_request{};
+  while (reader.next(request)) {
+    switch (request.type) {
+      case phonebook_request_type::add: {
+        phonebook.insert(request.number, request.name);
+        break;
+      }
+      case phonebook_request_type::del: {
+        phonebook.erase(request.number);
+        break;
+      }
+      case phonebook_request_type::find: {
+        const auto name = phonebook.find(request.number);
+        if (!name.empty()) {
+          out << name << '\n';
+        } else {
+          out << "not found\n";
+        }
+        break;
+      }
+      default : {
+        assert(false);
+        break;
+      }
+    }
+  }
+}
+
+// Phonebook split by the numbers into shards which are served in parallel. Requests
+// come in batches: a batch is spread over the shards keeping the order of its requests
+// within every shard, and the requests for one number always go to the same shard, so
+// they are served one after another as without the shards. A shard is served by one
+// thread at a time, batches served concurrently wait only for the shards they share
+class sharded_phonebook {
+ public:
+  sharded_phonebook(uint64_t number_bound, size_t shards_count)
+    : shards_{}
+  {
+    assert(shards_count > 0);
+    const auto shard_number_bound = (number_bound + shards_count - 1) / shards_count;
+    shards_.reserve(shards_count);
+    for (auto shard_id = size_t{0}; shard_id < shards_count; ++shard_id) {
+      shards_.emplace_back(new shard{std::mutex{}, direct_phonebook{shard_number_bound}});
+    }
+  }
+
+  // serve the requests in `threads_count` threads. `names[i]` becomes the name found
+  // by the i-th request, it is empty if the number is not found or the request is
+  // not a `find`
+  void serve_batch(
+      const std::vector<phonebook_request>& requests,
+      std::vector<std::string>& names,
+      size_t threads_count) {
+    const auto shards_count = shards_.size();
+    auto shard_offsets = std::vector<size_t>(shards_count + 1);
+    for (const auto& request : requests) {
+      ++shard_offsets[request.number % shards_count + 1];
+    }
+    for (auto shard_id = size_t{0}; shard_id < shards_count; ++shard_id) {
+      shard_offsets[shard_id + 1] += shard_offsets[shard_id];
+    }
+    auto request_ids = std::vector<size_t>(requests.size());
+    auto ends = std::vector<size_t>(shard_offsets.begin(), shard_offsets.end() - 1);
+    for (auto request_id = size_t{0}; request_id < requests.size(); ++request_id) {
+      request_ids[ends[requests[request_id].number % shards_count]++] = request_id;
+    }
+    names.resize(requests.size());
+    auto next_shard_id = std::atomic<size_t>{0};
+    auto serve = [&]() {
+      for (auto shard_id = next_shard_id++; shard_id < shards_count; shard_id = next_shard_id++) {
+        auto& shard = *shards_[shard_id];
+        const auto lock = std::lock_guard<std::mutex>{shard.mutex};
+        for (auto position = shard_offsets[shard_id]; position < shard_offsets[shard_id + 1]; ++position) {
+          const auto request_id = request_ids[position];
+          const auto& request = requests[request_id];
+          const auto number = request.number / shards_count;
+          names[request_id].clear();
+          switch (request.type) {
+            case phonebook_request_type::add: {
+              shard.phonebook.insert(number, request.name);
+              break;
+            }
+            case phonebook_request_type::del: {
+              shard.phonebook.erase(number);
+              break;
+            }
+            case phonebook_request_type::find: {
+              names[request_id].assign(shard.phonebook.find(number));
+              break;
+            }
+            default : {
+              assert(false);
+              break;
+            }
+          }
+        }
+      }
+    };
+    threads_count = std::max(size_t{1}, std::min(threads_count, shards_count));
+    auto threads = std::vector<std::thread>{};
+    for (auto thread_id = size_t{1}; thread_id < threads_count; ++thread_id) {
+      threads.emplace_back(serve);
+    }
+    serve();
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+ private:
+  struct shard {
+    std::mutex mutex;
+    direct_phonebook phonebook;
+  };
+
+ private:
+  std::vector<std::unique_ptr<shard>> shards_;
+};
+
+// serve the requests in batches of `batch_size` over all the cores
+void serve_requests_in_batches(
+    phonebook_request_reader& reader, sharded_phonebook& phonebook,
+    output_printer& out, size_t batch_size = size_t{1} << 16) {
+  const auto threads_count = std::max(1u, std::thread::hardware_concurrency());
+  auto requests = std::vector<phonebook_request>{};
+  auto names = std::vector<std::string>{};
+  while (reader.size() > 0) {
+    requests.resize(std::min(batch_size, reader.size()));
+    for (auto& request : requests) {
+      reader.next(request);
+    }
+    phonebook.serve_batch(requests, names, threads_count);
+    for (auto request_id = size_t{0}; request_id < requests.size(); ++request_id) {
+      if (requests[request_id].type != phonebook_request_type::find) {
+        continue;
+      }
+      if (!names[request_id].empty()) {
+        out << names[request_id] << '\n';
+      } else {
+        out << "not found\n";
+      }
+    }
+  }
+}
+
+// phone numbers of the task have at most seven digits
+constexpr auto phone_number_bound = uint64_t{10000000};
+
+// `--encode` converts the requests to the binary format, `--hashed` serves them with
+// a hash map instead of the table addressed by the numbers, `--sharded` serves them
+// in batches over all the cores
+int main(int argc, char* argv[]) {
+  auto input = input_scanner{stdin};
+  auto output = output_printer{stdout};
+  auto reader = phonebook_request_reader{input};
+  const auto option = argc > 1 ? std::string{argv[1]} : std::string{};
+  if (option == "--encode") {
+    encode_requests(reader, output);
+    return 0;
+  }
+  if (option == "--hashed") {
+    auto phonebook = hashed_phonebook{};
+    serve_requests(reader, phonebook, output);
+    return 0;
+  }
+  if (option == "--sharded") {
+    constexpr auto shards_count = size_t{64};
+    auto phonebook = sharded_phonebook{phone_number_bound, shards_count};
+    serve_requests_in_batches(reader, phonebook, output);
+    return 0;
   }
+  auto phonebook = direct_phonebook{phone_number_bound};
+  serve_requests(reader, phonebook, output);
   return 0;
 }
\ No newline at end of file
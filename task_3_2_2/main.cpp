@@ -1,12 +1,262 @@
 #include <cassert>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
 #include <vector>
 #include <list>
 #include <algorithm>
 
+// Reader of whitespace separated tokens. The input is read in large blocks and
+// the tokens are parsed straight from the block, bypassing the iostream machinery
+class input_scanner {
+ public:
+  explicit input_scanner(std::FILE* file, size_t block_size = size_t{1} << 16)
+    : file_{file}
+    , block_(block_size)
+    , position_{0}
+    , size_{0}
+    , good_{true}
+  {}
+
+  template <
+    typename Integer,
+    typename std::enable_if<std::is_integral<Integer>::value, int>::type = 0>
+  input_scanner& operator >> (Integer& value) {
+    skip_spaces();
+    const auto negative = (peek() == '-');
+    if (negative) {
+      ++position_;
+    }
+    auto result = Integer{0};
+    for (auto c = peek(); '0' <= c && c <= '9'; c = peek()) {
+      result = static_cast<Integer>(result * 10 + (c - '0'));
+      ++position_;
+    }
+    value = negative ? static_cast<Integer>(-result) : result;
+    return *this;
+  }
+
+  input_scanner& operator >> (char& value) {
+    skip_spaces();
+    const auto c = peek();
+    if (c != end_of_input) {
+      value = static_cast<char>(c);
+      ++position_;
+    }
+    return *this;
+  }
+
+  input_scanner& operator >> (std::string& value) {
+    skip_spaces();
+    value.clear();
+    while (peek() != end_of_input) {
+      auto last = position_;
+      while (last < size_ && !is_space(static_cast<unsigned char>(block_[last]))) {
+        ++last;
+      }
+      value.append(block_.data() + position_, last - position_);
+      position_ = last;
+      if (position_ < size_) {
+        break;
+      }
+    }
+    return *this;
+  }
+
+  // next byte of the input without consuming it, -1 at the end of the input
+  int next_byte() {
+    return peek();
+  }
+
+  // read the object representation of `value` as it is, without parsing
+  template <typename T>
+  input_scanner& read_binary(T& value) {
+    static_assert(std::is_trivially_copyable<T>::value, "value must be trivially copyable");
+    return read_bytes(reinterpret_cast<char*>(std::addressof(value)), sizeof(T));
+  }
+
+  // read next `count` bytes of the input as they are
+  input_scanner& read_bytes(char* data, size_t count) {
+    while (count > 0 && peek() != end_of_input) {
+      const auto chunk = std::min(count, size_ - position_);
+      std::memcpy(data, block_.data() + position_, chunk);
+      position_ += chunk;
+      data += chunk;
+      count -= chunk;
+    }
+    if (count > 0) {
+      good_ = false;
+    }
+    return *this;
+  }
+
+  // false once the input ended in the middle of a binary read
+  bool good() const {
+    return good_;
+  }
+
+ private:
+  static constexpr int end_of_input = -1;
+
+  static bool is_space(int c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+  }
+
+  int peek() {
+    if (position_ == size_) {
+      size_ = std::fread(block_.data(), 1, block_.size(), file_);
+      position_ = 0;
+      if (size_ == 0) {
+        return end_of_input;
+      }
+    }
+    return static_cast<unsigned char>(block_[position_]);
+  }
+
+  void skip_spaces() {
+    while (is_space(peek())) {
+      ++position_;
+    }
+  }
+
+  std::FILE* file_;
+  std::vector<char> block_;
+  size_t position_;
+  size_t size_;
+  bool good_;
+};
+
+// Writer of text output. The text is gathered in a large block which is written out
+// when it is full, on `flush` and on destruction. Integers are formatted by hand
+class output_printer {
+ public:
+  explicit output_printer(std::FILE* file, size_t block_size = size_t{1} << 16)
+    : file_{file}
+    , block_(block_size)
+    , size_{0}
+  {}
+
+  output_printer(const output_printer&) = delete;
+  output_printer& operator = (const output_printer&) = delete;
+
+  ~output_printer() {
+    flush();
+  }
+
+  template <
+    typename Integer,
+    typename std::enable_if<std::is_integral<Integer>::value, int>::type = 0>
+  output_printer& operator << (Integer value) {
+    using unsigned_type = typename std::make_unsigned<Integer>::type;
+    // room for the sign and all the digits
+    reserve(std::numeric_limits<unsigned_type>::digits10 + 2);
+    auto magnitude = static_cast<unsigned_type>(value);
+    if (value < Integer{0}) {
+      block_[size_++] = '-';
+      magnitude = unsigned_type{0} - magnitude;
+    }
+    char digits[std::numeric_limits<unsigned_type>::digits10 + 1];
+    auto count = size_t{0};
+    do {
+      digits[count++] = static_cast<char>('0' + magnitude % 10);
+      magnitude /= 10;
+    } while (magnitude != 0);
+    while (count > 0) {
+      block_[size_++] = digits[--count];
+    }
+    return *this;
+  }
+
+  output_printer& operator << (char value) {
+    reserve(1);
+    block_[size_++] = value;
+    return *this;
+  }
+
+  output_printer& operator << (const char* text) {
+    write(text, std::strlen(text));
+    return *this;
+  }
+
+  output_printer& operator << (const std::string& text) {
+    write(text.data(), text.size());
+    return *this;
+  }
+
+  // write the object representation of `value` as it is, without formatting
+  template <typename T>
+  output_printer& write_binary(const T& value) {
+    static_assert(std::is_trivially_copyable<T>::value, "value must be trivially copyable");
+    write(reinterpret_cast<const char*>(std::addressof(value)), sizeof(T));
+    return *this;
+  }
+
+  // write out everything printed so far
+  void flush() {
+    drain();
+    std::fflush(file_);
+  }
+
+ private:
+  void drain() {
+    std::fwrite(block_.data(), 1, size_, file_);
+    size_ = 0;
+  }
+
+  void reserve(size_t count) {
+    if (block_.size() - size_ < count) {
+      drain();
+    }
+  }
+
+  void write(const char* data, size_t count) {
+    reserve(count);
+    if (count > block_.size()) {
+      std::fwrite(data, 1, count, file_);
+      return;
+    }
+    std::memcpy(block_.data() + size_, data, count);
+    size_ += count;
+  }
+
+  std::FILE* file_;
+  std::vector<char> block_;
+  size_t size_;
+};
+
 namespace {
 
-size_t compute_hash(const std::string& text) {
+constexpr auto hash_base = uint64_t{263};
+constexpr auto hash_modulus = uint64_t{1000000007};
+// characters hashed per reduction
+constexpr auto hash_block_size = size_t{8};
+
+struct hash_base_powers {
+  uint64_t values[hash_block_size + 1];
+};
+
+constexpr hash_base_powers compute_hash_base_powers() {
+  auto powers = hash_base_powers{};
+  powers.values[0] = 1;
+  for (auto i = size_t{1}; i <= hash_block_size; ++i) {
+    powers.values[i] = powers.values[i - 1] * hash_base % hash_modulus;
+  }
+  return powers;
+}
+
+// hash_base^0, ..., hash_base^hash_block_size modulo hash_modulus
+constexpr auto hash_powers = compute_hash_base_powers();
+
+// the hash reduced after every operation, character by character. Characters above
+// 127 are negative, so their products wrap around in size_t before the reduction
+size_t compute_hash_by_character(const std::string& text) {
   const auto n = text.size();
   constexpr auto x = size_t{263};
   constexpr auto p = size_t{1000000007};
@@ -20,8 +270,49 @@ size_t compute_hash(const std::string& text) {
   return hash;
 }
 
+// the same value as `compute_hash_by_character`. The polynomial is evaluated by
+// Horner's rule from the end of the text, a block of characters at a time: the
+// characters of a block are multiplied by the precomputed powers and summed without
+// overflow, so a block costs one reduction. Texts with characters above 127 are left
+// to `compute_hash_by_character`
+size_t compute_hash(const std::string& text) {
+  auto i = text.size();
+  auto hash = uint64_t{0};
+  for (; i % hash_block_size != 0; --i) {
+    const auto code = static_cast<unsigned char>(text[i - 1]);
+    if (code > 127) {
+      return compute_hash_by_character(text);
+    }
+    hash = (hash * hash_base + code) % hash_modulus;
+  }
+  while (i != 0) {
+    i -= hash_block_size;
+    auto block = uint64_t{0};
+    auto codes = 0u;
+    for (auto j = size_t{0}; j < hash_block_size; ++j) {
+      const auto code = static_cast<unsigned char>(text[i + j]);
+      codes |= code;
+      block += code * hash_powers.values[j];
+    }
+    if (codes > 127) {
+      return compute_hash_by_character(text);
+    }
+    hash = (hash * hash_powers.values[hash_block_size] + block) % hash_modulus;
+  }
+  return static_cast<size_t>(hash);
+}
+
+// spread the bits of a record hash over a 64-bit word, so that its low and high bits
+// alike can choose a bucket
+uint64_t mix_hash(uint32_t hash) {
+  auto mixed = uint64_t{hash} * uint64_t{0x9E3779B97F4A7C15};
+  return mixed ^ (mixed >> 32);
+}
+
 }  // namespace
 
+// Phonebook with a list of records per page, the newest record first. Records are
+// looked up by a linear search in their page
 class phonebook {
  public:
   using page = std::list<std::string>;
@@ -76,41 +367,660 @@ class phonebook {
 };
 
 
-int main() {
-  auto pages_count = size_t{0};
-  std::cin >> pages_count;
-  auto requests_count = size_t{0};
-  std::cin >> requests_count;
-  auto notebook = phonebook{pages_count};
-  for (auto request_id = size_t{0}; request_id < requests_count; ++request_id) {
-    auto command = std::string{};
-    std::cin >> command;
-    if (command == "add") {
-      auto record = std::string{};
-      std::cin >> record;
-      notebook.insert(record);
-    } else if (command == "del") {
-      auto record = std::string{};
-      std::cin >> record;
-      notebook.erase(record);
-    } else if (command == "find") {
-      auto record = std::string{};
-      std::cin >> record;
-      if (notebook.contains(record)) {
-        std::cout << "yes\n";
+// Phonebook with the same pages as `phonebook`, but the records are kept in one flat
+// open addressing table instead of a list per page. Slots are probed in groups of
+// eight: a control byte per slot keeps seven bits of the mixed record hash, and a
+// whole group of control bytes is matched at once as a single 64-bit word. Every slot
+// keeps the full record hash, so the records are compared only when it matches, and
+// records are short enough to live inside the slot. The records of a page are linked
+// through the slots newest first, which is the order of the pages of `phonebook`
+class flat_phonebook {
+ private:
+  struct slot {
+    std::string record;
+    uint32_t hash = 0;
+    int32_t previous = -1;
+    int32_t next = -1;
+  };
+
+ public:
+  class page_iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::string;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const std::string*;
+    using reference = const std::string&;
+
+    page_iterator(const std::vector<slot>& slots, int32_t slot_id)
+      : slots_{&slots}
+      , slot_id_{slot_id}
+    {}
+
+    reference operator * () const {
+      return (*slots_)[slot_id_].record;
+    }
+
+    pointer operator -> () const {
+      return &(*slots_)[slot_id_].record;
+    }
+
+    page_iterator& operator ++ () {
+      slot_id_ = (*slots_)[slot_id_].next;
+      return *this;
+    }
+
+    page_iterator operator ++ (int) {
+      auto result = *this;
+      ++*this;
+      return result;
+    }
+
+    bool operator == (const page_iterator& other) const {
+      return slot_id_ == other.slot_id_;
+    }
+
+    bool operator != (const page_iterator& other) const {
+      return slot_id_ != other.slot_id_;
+    }
+
+   private:
+    const std::vector<slot>* slots_;
+    int32_t slot_id_;
+  };
+
+  // records of a page, newest first
+  class page_view {
+   public:
+    page_view(const std::vector<slot>& slots, int32_t first_slot_id)
+      : slots_{&slots}
+      , first_slot_id_{first_slot_id}
+    {}
+
+    page_iterator begin() const {
+      return page_iterator{*slots_, first_slot_id_};
+    }
+
+    page_iterator end() const {
+      return page_iterator{*slots_, -1};
+    }
+
+    bool empty() const {
+      return first_slot_id_ == -1;
+    }
+
+   private:
+    const std::vector<slot>* slots_;
+    int32_t first_slot_id_;
+  };
+
+  flat_phonebook(size_t page_count)
+    : pages_(page_count, -1)
+    , controls_(group_size, empty_control)
+    , slots_(group_size)
+    , group_mask_{0}
+    , growth_left_{max_load(group_size)}
+  {}
+
+  void insert(const std::string& text) {
+    const auto hash = static_cast<uint32_t>(compute_hash(text));
+    if (find_slot(text, hash) == -1) {
+      if (growth_left_ == 0) {
+        rehash();
+      }
+      const auto slot_id = find_free_slot(hash);
+      if (controls_[slot_id] == empty_control) {
+        --growth_left_;
+      }
+      controls_[slot_id] = short_hash(hash);
+      slots_[slot_id].record = text;
+      slots_[slot_id].hash = hash;
+      link_front(slot_id);
+    }
+  }
+
+  void erase(const std::string& text) {
+    const auto slot_id = find_slot(text, static_cast<uint32_t>(compute_hash(text)));
+    if (slot_id != -1) {
+      unlink(slot_id);
+      controls_[slot_id] = deleted_control;
+      slots_[slot_id].record.clear();
+    }
+  }
+
+  bool contains(const std::string& text) const {
+    return find_slot(text, static_cast<uint32_t>(compute_hash(text))) != -1;
+  }
+
+  page_view get_page(const size_t number) const {
+    assert(number < page_count());
+    return page_view{slots_, pages_[number]};
+  }
+
+  size_t page_count() const {
+    return pages_.size();
+  }
+
+ private:
+  static constexpr auto group_size = size_t{8};
+  static constexpr auto empty_control = uint8_t{0x80};
+  static constexpr auto deleted_control = uint8_t{0xFE};
+  static constexpr auto low_bits = uint64_t{0x0101010101010101};
+  static constexpr auto high_bits = uint64_t{0x8080808080808080};
+
+  // at most 7/8 of the slots are used, deleted ones included
+  static size_t max_load(size_t slots_count) {
+    return slots_count - slots_count / 8;
+  }
+
+  // control byte of a used slot, its high bit is always clear
+  static uint8_t short_hash(uint32_t hash) {
+    return static_cast<uint8_t>(mix_hash(hash) & 0x7F);
+  }
+
+  size_t first_group(uint32_t hash) const {
+    return static_cast<size_t>(mix_hash(hash) >> 7) & group_mask_;
+  }
+
+  // control bytes of the group, the byte of the first slot is the lowest one
+  uint64_t load_group(size_t group) const {
+    auto controls = uint64_t{0};
+    for (auto i = size_t{0}; i < group_size; ++i) {
+      controls |= uint64_t{controls_[group * group_size + i]} << (8 * i);
+    }
+    return controls;
+  }
+
+  // high bits of the bytes equal to `control`. A byte right above a matching one may
+  // be reported too, the callers check every reported slot anyway
+  static uint64_t match(uint64_t controls, uint8_t control) {
+    const auto difference = controls ^ (low_bits * control);
+    return (difference - low_bits) & ~difference & high_bits;
+  }
+
+  static uint64_t match_empty(uint64_t controls) {
+    return controls & ~(controls << 6) & high_bits;
+  }
+
+  static uint64_t match_free(uint64_t controls) {
+    return controls & high_bits;
+  }
+
+  static size_t lowest_slot(uint64_t matches) {
+    return static_cast<size_t>(__builtin_ctzll(matches)) / 8;
+  }
+
+  // slot holding `text`, -1 if there is no such slot. The groups are probed with
+  // growing steps, which visits all the groups as their number is a power of two
+  int32_t find_slot(const std::string& text, uint32_t hash) const {
+    const auto control = short_hash(hash);
+    auto group = first_group(hash);
+    for (auto step = size_t{1}; ; ++step) {
+      const auto controls = load_group(group);
+      for (auto matches = match(controls, control); matches != 0; matches &= matches - 1) {
+        const auto slot_id = group * group_size + lowest_slot(matches);
+        if (slots_[slot_id].hash == hash && slots_[slot_id].record == text) {
+          return static_cast<int32_t>(slot_id);
+        }
+      }
+      if (match_empty(controls) != 0) {
+        return -1;
+      }
+      group = (group + step) & group_mask_;
+    }
+  }
+
+  // first empty or deleted slot on the probe path of `hash`
+  int32_t find_free_slot(uint32_t hash) const {
+    auto group = first_group(hash);
+    for (auto step = size_t{1}; ; ++step) {
+      const auto matches = match_free(load_group(group));
+      if (matches != 0) {
+        return static_cast<int32_t>(group * group_size + lowest_slot(matches));
+      }
+      group = (group + step) & group_mask_;
+    }
+  }
+
+  void link_front(int32_t slot_id) {
+    auto& head = pages_[slots_[slot_id].hash % pages_.size()];
+    slots_[slot_id].previous = -1;
+    slots_[slot_id].next = head;
+    if (head != -1) {
+      slots_[head].previous = slot_id;
+    }
+    head = slot_id;
+  }
+
+  void unlink(int32_t slot_id) {
+    const auto previous = slots_[slot_id].previous;
+    const auto next = slots_[slot_id].next;
+    if (previous == -1) {
+      pages_[slots_[slot_id].hash % pages_.size()] = next;
+    } else {
+      slots_[previous].next = next;
+    }
+    if (next != -1) {
+      slots_[next].previous = previous;
+    }
+  }
+
+  // move the records into a fresh table, twice as large unless most of the used slots
+  // were deleted. The pages are moved oldest record first to keep their order
+  void rehash() {
+    auto records_count = size_t{0};
+    for (const auto& control : controls_) {
+      records_count += (control & 0x80) == 0;
+    }
+    auto slots_count = slots_.size();
+    if (records_count >= max_load(slots_count) / 2) {
+      slots_count *= 2;
+    }
+    auto old_slots = std::vector<slot>(slots_count);
+    old_slots.swap(slots_);
+    controls_.assign(slots_count, empty_control);
+    group_mask_ = slots_count / group_size - 1;
+    growth_left_ = max_load(slots_count) - records_count;
+    auto page_slot_ids = std::vector<int32_t>{};
+    for (auto& head : pages_) {
+      page_slot_ids.clear();
+      for (auto slot_id = head; slot_id != -1; slot_id = old_slots[slot_id].next) {
+        page_slot_ids.push_back(slot_id);
+      }
+      head = -1;
+      for (auto old_slot_id = page_slot_ids.rbegin(); old_slot_id != page_slot_ids.rend(); ++old_slot_id) {
+        auto& old_slot = old_slots[*old_slot_id];
+        const auto slot_id = find_free_slot(old_slot.hash);
+        controls_[slot_id] = short_hash(old_slot.hash);
+        slots_[slot_id].record = std::move(old_slot.record);
+        slots_[slot_id].hash = old_slot.hash;
+        link_front(slot_id);
+      }
+    }
+  }
+
+ private:
+  // first slot of every page, -1 for an empty page
+  std::vector<int32_t> pages_;
+  std::vector<uint8_t> controls_;
+  std::vector<slot> slots_;
+  size_t group_mask_;
+  size_t growth_left_;
+};
+
+// Index of values by their hashes which grows with the number of values by linear
+// hashing. Whenever there are more than `max_load_factor` values per bucket, one more
+// bucket is added and only the values of the bucket it splits from are moved, so the
+// index is rehashed a bucket at a time and no single insertion pays for a whole
+// rehash. The buckets are kept in fixed size segments, so adding a bucket never moves
+// the others either
+template <typename Value>
+class incremental_hash_index {
+ public:
+  explicit incremental_hash_index(double max_load_factor = 1.0)
+    : segments_{}
+    , round_buckets_{initial_buckets}
+    , split_bucket_{0}
+    , size_{0}
+    , max_load_factor_{max_load_factor}
+  {
+    assert(max_load_factor_ > 0.0);
+    segments_.emplace_back(segment_size);
+  }
+
+  // value with the `hash` for which `matches` holds, nullptr if there is no such value
+  template <typename Matches>
+  const Value* find(uint32_t hash, Matches matches) const {
+    for (const auto& item : bucket_at(bucket_index(hash))) {
+      if (item.hash == hash && matches(item.value)) {
+        return &item.value;
+      }
+    }
+    return nullptr;
+  }
+
+  // the value must not be in the index yet
+  void insert(uint32_t hash, Value value) {
+    bucket_at(bucket_index(hash)).push_back(entry{hash, std::move(value)});
+    ++size_;
+    if (size_ > max_load_factor_ * bucket_count()) {
+      split();
+    }
+  }
+
+  void erase(uint32_t hash, const Value& value) {
+    auto& items = bucket_at(bucket_index(hash));
+    for (auto& item : items) {
+      if (item.hash == hash && item.value == value) {
+        item = std::move(items.back());
+        items.pop_back();
+        --size_;
+        break;
+      }
+    }
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  size_t bucket_count() const {
+    return round_buckets_ + split_bucket_;
+  }
+
+ private:
+  struct entry {
+    uint32_t hash;
+    Value value;
+  };
+
+  using bucket = std::vector<entry>;
+
+  static constexpr auto initial_buckets = size_t{8};
+  static constexpr auto segment_size = size_t{1024};
+
+  // the buckets below `split_bucket_` are already split in this round, their values
+  // are spread over twice as many buckets
+  size_t bucket_index(uint32_t hash) const {
+    const auto mixed = mix_hash(hash);
+    const auto index = static_cast<size_t>(mixed & (round_buckets_ - 1));
+    if (index < split_bucket_) {
+      return static_cast<size_t>(mixed & (2 * round_buckets_ - 1));
+    }
+    return index;
+  }
+
+  const bucket& bucket_at(size_t index) const {
+    return segments_[index / segment_size][index % segment_size];
+  }
+
+  bucket& bucket_at(size_t index) {
+    return segments_[index / segment_size][index % segment_size];
+  }
+
+  // add a bucket and move into it the values of the bucket which it splits from
+  void split() {
+    const auto new_index = bucket_count();
+    if (new_index % segment_size == 0) {
+      segments_.emplace_back(segment_size);
+    }
+    auto& old_items = bucket_at(split_bucket_);
+    auto& new_items = bucket_at(new_index);
+    const auto mask = 2 * round_buckets_ - 1;
+    for (auto position = size_t{0}; position < old_items.size(); ) {
+      if ((mix_hash(old_items[position].hash) & mask) == new_index) {
+        new_items.push_back(std::move(old_items[position]));
+        old_items[position] = std::move(old_items.back());
+        old_items.pop_back();
       } else {
-        std::cout << "no\n";
+        ++position;
       }
-    } else if (command == "check") {
-      auto number = size_t{0};
-      std::cin >> number;
-      assert(number < notebook.page_count());
-      for (const auto& record : notebook.get_page(number)) {
-        std::cout << record << ' ';
+    }
+    ++split_bucket_;
+    if (split_bucket_ == round_buckets_) {
+      round_buckets_ *= 2;
+      split_bucket_ = 0;
+    }
+  }
+
+ private:
+  std::vector<std::vector<bucket>> segments_;
+  // buckets at the start of the current round of splits, a power of two
+  size_t round_buckets_;
+  size_t split_bucket_;
+  size_t size_;
+  double max_load_factor_;
+};
+
+// Phonebook with the pages of `phonebook` which stays fast when there are many more
+// records than pages. The pages are only kept for `check`, the records are looked up
+// through an index which grows with them a bucket at a time
+class growing_phonebook {
+ public:
+  using page = phonebook::page;
+
+ private:
+  using record_position = page::iterator;
+
+  struct same_record {
+    bool operator () (const record_position& position) const {
+      return *position == text;
+    }
+
+    const std::string& text;
+  };
+
+ public:
+  explicit growing_phonebook(size_t page_count, double max_load_factor = 1.0)
+    : pages_{page_count}
+    , index_{max_load_factor}
+  {}
+
+  void insert(const std::string& text) {
+    const auto hash = static_cast<uint32_t>(compute_hash(text));
+    if (index_.find(hash, same_record{text}) == nullptr) {
+      auto& page = pages_[hash % pages_.size()];
+      page.push_front(text);
+      index_.insert(hash, std::begin(page));
+    }
+  }
+
+  void erase(const std::string& text) {
+    const auto hash = static_cast<uint32_t>(compute_hash(text));
+    const auto found = index_.find(hash, same_record{text});
+    if (found != nullptr) {
+      const auto here = *found;
+      index_.erase(hash, here);
+      pages_[hash % pages_.size()].erase(here);
+    }
+  }
+
+  bool contains(const std::string& text) const {
+    const auto hash = static_cast<uint32_t>(compute_hash(text));
+    return index_.find(hash, same_record{text}) != nullptr;
+  }
+
+  const page& get_page(const size_t number) const {
+    assert(number < page_count());
+    return pages_[number];
+  }
+
+  size_t page_count() const {
+    return pages_.size();
+  }
+
+ private:
+  std::vector<page> pages_;
+  incremental_hash_index<record_position> index_;
+};
+
+enum class phonebook_request_type : uint8_t {
+  add,
+  del,
+  find,
+  check
+};
+
+struct phonebook_request {
+  phonebook_request_type type;
+  uint64_t number;
+  std::string record;
+};
+
+// Requests come as text or in the binary format. The binary format is the marker
+// byte, the pages count and the requests count as uint64_t and the requests, every
+// request is the type byte followed by the uint64_t page number for `check` or by the
+// uint32_t length of the record and the record itself for the other requests.
+// Numbers are in the byte order of the machine
+constexpr auto binary_requests_marker = 0xB1;
+
+// requests which can be neither served nor encoded stop the program in any build
+[[noreturn]] void reject_requests(const char* reason) {
+  std::fprintf(stderr, "phonebook requests: %s\n", reason);
+  std::exit(EXIT_FAILURE);
+}
+
+// Stream of requests, every request is parsed only when it is asked for
+class phonebook_request_reader {
+ public:
+  explicit phonebook_request_reader(input_scanner& in)
+    : in_{in}
+    , pages_count_{0}
+    , requests_left_{0}
+    , binary_{in.next_byte() == binary_requests_marker}
+  {
+    if (binary_) {
+      auto marker = uint8_t{0};
+      auto pages_count = uint64_t{0};
+      auto requests_count = uint64_t{0};
+      in_.read_binary(marker).read_binary(pages_count).read_binary(requests_count);
+      pages_count_ = pages_count;
+      requests_left_ = requests_count;
+    } else {
+      in_ >> pages_count_ >> requests_left_;
+    }
+  }
+
+  size_t pages_count() const {
+    return pages_count_;
+  }
+
+  // number of requests which are not read yet
+  size_t size() const {
+    return requests_left_;
+  }
+
+  // parse next request into `request`, false when the requests are over
+  bool next(phonebook_request& request) {
+    if (requests_left_ == 0) {
+      return false;
+    }
+    --requests_left_;
+    if (binary_) {
+      in_.read_binary(request.type);
+      if (request.type > phonebook_request_type::check) {
+        reject_requests("unknown request type");
       }
-      std::cout << '\n';
+      if (request.type == phonebook_request_type::check) {
+        in_.read_binary(request.number);
+      } else {
+        auto length = uint32_t{0};
+        in_.read_binary(length);
+        request.record.resize(length);
+        in_.read_bytes(&request.record[0], length);
+      }
+      if (!in_.good()) {
+        reject_requests("binary requests end in the middle of a request");
+      }
+      return true;
+    }
+    in_ >> command_;
+    if (command_ == "add") {
+      request.type = phonebook_request_type::add;
+      in_ >> request.record;
+    } else if (command_ == "del") {
+      request.type = phonebook_request_type::del;
+      in_ >> request.record;
+    } else if (command_ == "find") {
+      request.type = phonebook_request_type::find;
+      in_ >> request.record;
+    } else if (command_ == "check") {
+      request.type = phonebook_request_type::check;
+      in_ >> request.number;
     } else {
       assert(false);
     }
+    return true;
+  }
+
+ private:
+  input_scanner& in_;
+  size_t pages_count_;
+  size_t requests_left_;
+  bool binary_;
+  std::string command_;
+};
+
+// convert requests to the binary format
+void encode_requests(phonebook_request_reader& reader, output_printer& out) {
+  out.write_binary(static_cast<uint8_t>(binary_requests_marker));
+  out.write_binary(static_cast<uint64_t>(reader.pages_count()));
+  out.write_binary(static_cast<uint64_t>(reader.size()));
+  auto request = phonebook_request{};
+  while (reader.next(request)) {
+    out.write_binary(request.type);
+    if (request.type == phonebook_request_type::check) {
+      out.write_binary(request.number);
+    } else {
+      if (request.record.size() > std::numeric_limits<uint32_t>::max()) {
+        reject_requests("record is too long for the binary format");
+      }
+      out.write_binary(static_cast<uint32_t>(request.record.size()));
+      out << request.record;
+    }
+  }
+}
+
+template <typename Phonebook>
+void serve_requests(phonebook_request_reader& reader, Phonebook& notebook, output_printer& out) {
+  auto request = phonebook_request{};
+  while (reader.next(request)) {
+    switch (request.type) {
+      case phonebook_request_type::add: {
+        notebook.insert(request.record);
+        break;
+      }
+      case phonebook_request_type::del: {
+        notebook.erase(request.record);
+        break;
+      }
+      case phonebook_request_type::find: {
+        if (notebook.contains(request.record)) {
+          out << "yes\n";
+        } else {
+          out << "no\n";
+        }
+        break;
+      }
+      case phonebook_request_type::check: {
+        assert(request.number < notebook.page_count());
+        for (const auto& record : notebook.get_page(request.number)) {
+          out << record << ' ';
+        }
+        out << '\n';
+        break;
+      }
+      default : {
+        assert(false);
+        break;
+      }
+    }
   }
-};
\ No newline at end of file
+}
+
+// `--encode` converts the requests to the binary format, `--growing` serves them with
+// the phonebook whose index grows with the records and `--list` with the list per
+// page instead of the flat table
+int main(int argc, char* argv[]) {
+  auto input = input_scanner{stdin};
+  auto output = output_printer{stdout};
+  auto reader = phonebook_request_reader{input};
+  const auto option = argc > 1 ? std::string{argv[1]} : std::string{};
+  if (option == "--encode") {
+    encode_requests(reader, output);
+    return 0;
+  }
+  if (option == "--growing") {
+    auto notebook = growing_phonebook{reader.pages_count()};
+    serve_requests(reader, notebook, output);
+    return 0;
+  }
+  if (option == "--list") {
+    auto notebook = phonebook{reader.pages_count()};
+    serve_requests(reader, notebook, output);
+    return 0;
+  }
+  auto notebook = flat_phonebook{reader.pages_count()};
+  serve_requests(reader, notebook, output);
+  return 0;
+}
@@ -1,9 +1,104 @@
 #include <cassert>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <string>
+#include <type_traits>
 #include <vector>
 #include <algorithm>
 #include <numeric>
 
+// Writer of text output. The text is gathered in a large block which is written out
+// when it is full, on `flush` and on destruction. Integers are formatted by hand
+class output_printer {
+ public:
+  explicit output_printer(std::FILE* file, size_t block_size = size_t{1} << 16)
+    : file_{file}
+    , block_(block_size)
+    , size_{0}
+  {}
+
+  output_printer(const output_printer&) = delete;
+  output_printer& operator = (const output_printer&) = delete;
+
+  ~output_printer() {
+    flush();
+  }
+
+  template <
+    typename Integer,
+    typename std::enable_if<std::is_integral<Integer>::value, int>::type = 0>
+  output_printer& operator << (Integer value) {
+    using unsigned_type = typename std::make_unsigned<Integer>::type;
+    // room for the sign and all the digits
+    reserve(std::numeric_limits<unsigned_type>::digits10 + 2);
+    auto magnitude = static_cast<unsigned_type>(value);
+    if (value < Integer{0}) {
+      block_[size_++] = '-';
+      magnitude = unsigned_type{0} - magnitude;
+    }
+    char digits[std::numeric_limits<unsigned_type>::digits10 + 1];
+    auto count = size_t{0};
+    do {
+      digits[count++] = static_cast<char>('0' + magnitude % 10);
+      magnitude /= 10;
+    } while (magnitude != 0);
+    while (count > 0) {
+      block_[size_++] = digits[--count];
+    }
+    return *this;
+  }
+
+  output_printer& operator << (char value) {
+    reserve(1);
+    block_[size_++] = value;
+    return *this;
+  }
+
+  output_printer& operator << (const char* text) {
+    write(text, std::strlen(text));
+    return *this;
+  }
+
+  output_printer& operator << (const std::string& text) {
+    write(text.data(), text.size());
+    return *this;
+  }
+
+  // write out everything printed so far
+  void flush() {
+    drain();
+    std::fflush(file_);
+  }
+
+ private:
+  void drain() {
+    std::fwrite(block_.data(), 1, size_, file_);
+    size_ = 0;
+  }
+
+  void reserve(size_t count) {
+    if (block_.size() - size_ < count) {
+      drain();
+    }
+  }
+
+  void write(const char* data, size_t count) {
+    reserve(count);
+    if (count > block_.size()) {
+      std::fwrite(data, 1, count, file_);
+      return;
+    }
+    std::memcpy(block_.data() + size_, data, count);
+    size_ += count;
+  }
+
+  std::FILE* file_;
+  std::vector<char> block_;
+  size_t size_;
+};
+
 uint32_t sum_mod(uint32_t lhs, uint32_t rhs, uint32_t mod) {
   return static_cast<uint32_t>(
     (static_cast<uint64_t>(lhs) + static_cast<uint64_t>(rhs)) %
@@ -95,8 +190,9 @@ uint32_t div_mod(uint32_t lhs, uint32_t rhs, uint32_t mod) {
   return mul_mod(lhs, inv_mod(rhs, mod), mod);
 }
 
+// the hash reduced after every operation, character by character
 template <typename Iter>
-uint32_t compute_hash(Iter first, Iter last, uint32_t base, uint32_t mod) {
+uint32_t compute_hash_by_character(Iter first, Iter last, uint32_t base, uint32_t mod) {
   auto base_power = uint32_t{1};
   auto hash = uint32_t{0};
   for (auto it = first; it != last; ++it) {
@@ -108,6 +204,51 @@ uint32_t compute_hash(Iter first, Iter last, uint32_t base, uint32_t mod) {
   return hash;
 }
 
+// the same value as `compute_hash_by_character`. The polynomial is evaluated by
+// Horner's rule from the end of the range, eight characters at a time: the characters
+// of a block are multiplied by the powers of the base and summed without overflow,
+// so a block costs one reduction. Ranges with characters above 127 and moduli of
+// 2^31 and more are left to `compute_hash_by_character`
+template <typename Iter>
+uint32_t compute_hash(Iter first, Iter last, uint32_t base, uint32_t mod) {
+  constexpr auto block_size = size_t{8};
+  if (mod > (uint32_t{1} << 31)) {
+    return compute_hash_by_character(first, last, base, mod);
+  }
+  auto i = static_cast<size_t>(last - first);
+  auto hash = uint64_t{0};
+  for (; i % block_size != 0; --i) {
+    const auto code = static_cast<uint32_t>(first[i - 1]);
+    if (code > 127) {
+      return compute_hash_by_character(first, last, base, mod);
+    }
+    hash = (hash * base + code) % mod;
+  }
+  if (i == 0) {
+    return static_cast<uint32_t>(hash);
+  }
+  uint64_t base_powers[block_size + 1];
+  base_powers[0] = 1 % mod;
+  for (auto j = size_t{1}; j <= block_size; ++j) {
+    base_powers[j] = mul_mod(static_cast<uint32_t>(base_powers[j - 1]), base, mod);
+  }
+  while (i != 0) {
+    i -= block_size;
+    auto block = uint64_t{0};
+    auto codes = uint32_t{0};
+    for (auto j = size_t{0}; j < block_size; ++j) {
+      const auto code = static_cast<uint32_t>(first[i + j]);
+      codes |= code;
+      block += code * base_powers[j];
+    }
+    if (codes > 127) {
+      return compute_hash_by_character(first, last, base, mod);
+    }
+    hash = (hash * base_powers[block_size] + block) % mod;
+  }
+  return static_cast<uint32_t>(hash);
+}
+
 uint32_t update_hash(
   uint32_t hash, char old_char, char new_char, uint32_t base, uint32_t mod, uint32_t base_power, uint32_t inv_base) {
   // std::cout << "old_char = " << old_char << '\n';
@@ -174,13 +315,14 @@ std::vector<size_t> find_substring(const std::string& pattern, const std::string
 }
 
 int main() {
+  auto output = output_printer{stdout};
   auto pattern = std::string{};
   std::cin >> pattern;
   auto text = std::string{};
   std::cin >> text;
   auto positions = find_substring(pattern, text);
   for (const auto& position : positions) {
-    std::cout << position << ' ';
+    output << position << ' ';
   }
   return 0;
 };
\ No newline at end of file
@@ -1,54 +1,307 @@
 #include <cassert>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
 #include <vector>
 
+// Reader of whitespace separated tokens. The input is read in large blocks and
+// the tokens are parsed straight from the block, bypassing the iostream machinery
+class input_scanner {
+ public:
+  explicit input_scanner(std::FILE* file, size_t block_size = size_t{1} << 16)
+    : file_{file}
+    , block_(block_size)
+    , position_{0}
+    , size_{0}
+  {}
+
+  template <
+    typename Integer,
+    typename std::enable_if<std::is_integral<Integer>::value, int>::type = 0>
+  input_scanner& operator >> (Integer& value) {
+    skip_spaces();
+    const auto negative = (peek() == '-');
+    if (negative) {
+      ++position_;
+    }
+    auto result = Integer{0};
+    for (auto c = peek(); '0' <= c && c <= '9'; c = peek()) {
+      result = static_cast<Integer>(result * 10 + (c - '0'));
+      ++position_;
+    }
+    value = negative ? static_cast<Integer>(-result) : result;
+    return *this;
+  }
+
+  input_scanner& operator >> (char& value) {
+    skip_spaces();
+    const auto c = peek();
+    if (c != end_of_input) {
+      value = static_cast<char>(c);
+      ++position_;
+    }
+    return *this;
+  }
+
+  input_scanner& operator >> (std::string& value) {
+    skip_spaces();
+    value.clear();
+    while (peek() != end_of_input) {
+      auto last = position_;
+      while (last < size_ && !is_space(static_cast<unsigned char>(block_[last]))) {
+        ++last;
+      }
+      value.append(block_.data() + position_, last - position_);
+      position_ = last;
+      if (position_ < size_) {
+        break;
+      }
+    }
+    return *this;
+  }
+
+ private:
+  static constexpr int end_of_input = -1;
+
+  static bool is_space(int c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+  }
+
+  int peek() {
+    if (position_ == size_) {
+      size_ = std::fread(block_.data(), 1, block_.size(), file_);
+      position_ = 0;
+      if (size_ == 0) {
+        return end_of_input;
+      }
+    }
+    return static_cast<unsigned char>(block_[position_]);
+  }
+
+  void skip_spaces() {
+    while (is_space(peek())) {
+      ++position_;
+    }
+  }
+
+  std::FILE* file_;
+  std::vector<char> block_;
+  size_t position_;
+  size_t size_;
+};
+
+// Writer of text output. The text is gathered in a large block which is written out
+// when it is full, on `flush` and on destruction. Integers are formatted by hand
+class output_printer {
+ public:
+  explicit output_printer(std::FILE* file, size_t block_size = size_t{1} << 16)
+    : file_{file}
+    , block_(block_size)
+    , size_{0}
+  {}
+
+  output_printer(const output_printer&) = delete;
+  output_printer& operator = (const output_printer&) = delete;
+
+  ~output_printer() {
+    flush();
+  }
+
+  template <
+    typename Integer,
+    typename std::enable_if<std::is_integral<Integer>::value, int>::type = 0>
+  output_printer& operator << (Integer value) {
+    using unsigned_type = typename std::make_unsigned<Integer>::type;
+    // room for the sign and all the digits
+    reserve(std::numeric_limits<unsigned_type>::digits10 + 2);
+    auto magnitude = static_cast<unsigned_type>(value);
+    if (value < Integer{0}) {
+      block_[size_++] = '-';
+      magnitude = unsigned_type{0} - magnitude;
+    }
+    char digits[std::numeric_limits<unsigned_type>::digits10 + 1];
+    auto count = size_t{0};
+    do {
+      digits[count++] = static_cast<char>('0' + magnitude % 10);
+      magnitude /= 10;
+    } while (magnitude != 0);
+    while (count > 0) {
+      block_[size_++] = digits[--count];
+    }
+    return *this;
+  }
+
+  output_printer& operator << (char value) {
+    reserve(1);
+    block_[size_++] = value;
+    return *this;
+  }
+
+  output_printer& operator << (const char* text) {
+    write(text, std::strlen(text));
+    return *this;
+  }
+
+  output_printer& operator << (const std::string& text) {
+    write(text.data(), text.size());
+    return *this;
+  }
+
+  // write out everything printed so far
+  void flush() {
+    drain();
+    std::fflush(file_);
+  }
+
+ private:
+  void drain() {
+    std::fwrite(block_.data(), 1, size_, file_);
+    size_ = 0;
+  }
+
+  void reserve(size_t count) {
+    if (block_.size() - size_ < count) {
+      drain();
+    }
+  }
+
+  void write(const char* data, size_t count) {
+    reserve(count);
+    if (count > block_.size()) {
+      std::fwrite(data, 1, count, file_);
+      return;
+    }
+    std::memcpy(block_.data() + size_, data, count);
+    size_ += count;
+  }
+
+  std::FILE* file_;
+  std::vector<char> block_;
+  size_t size_;
+};
+
 struct tree_node {
   int key;
   int left;
   int right;
 };
 
-void in_order_printer(int node_id, const std::vector<tree_node>& nodes, std::ostream& out) {
-  if (node_id == -1) {
-    return;
+struct tree_orders {
+  std::vector<int> in_order;
+  std::vector<int> pre_order;
+  std::vector<int> post_order;
+};
+
+// renumber the nodes of the tree under node `root_id` in breadth-first order: the root
+// gets id 0, then come the nodes of the next levels, left to right. Children of
+// consecutive nodes are consecutive, so passes over the new layout are sequential.
+// The queue of the search is known ahead, its nodes are fetched a few steps early
+std::vector<tree_node> relayout_breadth_first(
+    int root_id, const std::vector<tree_node>& nodes) {
+  constexpr auto lookahead = size_t{16};
+  auto queue = std::vector<int>{};
+  queue.reserve(nodes.size());
+  auto layout = std::vector<tree_node>{};
+  layout.reserve(nodes.size());
+  if (root_id != -1) {
+    queue.emplace_back(root_id);
+  }
+  for (auto position = size_t{0}; position < queue.size(); ++position) {
+    if (position + lookahead < queue.size()) {
+      __builtin_prefetch(std::addressof(nodes[queue[position + lookahead]]));
+    }
+    const auto& node = nodes[queue[position]];
+    auto relaid_node = tree_node{node.key, -1, -1};
+    if (node.left != -1) {
+      relaid_node.left = static_cast<int>(queue.size());
+      queue.emplace_back(node.left);
+    }
+    if (node.right != -1) {
+      relaid_node.right = static_cast<int>(queue.size());
+      queue.emplace_back(node.right);
+    }
+    layout.emplace_back(relaid_node);
   }
-  in_order_printer(nodes[node_id].left, nodes, out);
-  out << nodes[node_id].key << ' ';
-  in_order_printer(nodes[node_id].right, nodes, out);
+  return layout;
 }
 
-void pre_order_printer(int node_id, const std::vector<tree_node>& nodes, std::ostream& out) {
-  if (node_id == -1) {
-    return;
+// keys of the tree in all three orders. The tree must be laid out in breadth-first
+// order, see `relayout_breadth_first`. A subtree takes a contiguous range in every
+// order, so sizes of the subtrees, computed from the last node back, give the range
+// of every subtree and the place of its root in it. Both passes go over the nodes in
+// their order, the keys are put straight to their places
+tree_orders traverse_breadth_first_layout(const std::vector<tree_node>& layout) {
+  const auto nodes_count = layout.size();
+  auto sizes = std::vector<int>(nodes_count);
+  for (auto node_id = nodes_count; node_id > 0; --node_id) {
+    const auto& node = layout[node_id - 1];
+    sizes[node_id - 1] = 1 +
+      (node.left != -1 ? sizes[node.left] : 0) + (node.right != -1 ? sizes[node.right] : 0);
+  }
+  // first place of the subtree of every node in every order
+  struct subtree_start {
+    int in_order;
+    int pre_order;
+    int post_order;
+  };
+  auto starts = std::vector<subtree_start>(nodes_count);
+  auto orders = tree_orders{};
+  orders.in_order.resize(nodes_count);
+  orders.pre_order.resize(nodes_count);
+  orders.post_order.resize(nodes_count);
+  for (auto node_id = size_t{0}; node_id < nodes_count; ++node_id) {
+    const auto& node = layout[node_id];
+    const auto& start = starts[node_id];
+    const auto left_size = (node.left != -1 ? sizes[node.left] : 0);
+    orders.in_order[start.in_order + left_size] = node.key;
+    orders.pre_order[start.pre_order] = node.key;
+    orders.post_order[start.post_order + sizes[node_id] - 1] = node.key;
+    if (node.left != -1) {
+      starts[node.left] = subtree_start{start.in_order, start.pre_order + 1, start.post_order};
+    }
+    if (node.right != -1) {
+      starts[node.right] = subtree_start{
+        start.in_order + left_size + 1,
+        start.pre_order + left_size + 1,
+        start.post_order + left_size};
+    }
   }
-  out << nodes[node_id].key << ' ';
-  pre_order_printer(nodes[node_id].left, nodes, out);
-  pre_order_printer(nodes[node_id].right, nodes, out);
+  return orders;
+}
+
+// keys of the tree under node `root_id` in all three orders. The tree is laid out
+// breadth-first first, so the depth of the tree is not limited by the call stack
+tree_orders traverse_tree(int root_id, const std::vector<tree_node>& nodes) {
+  return traverse_breadth_first_layout(relayout_breadth_first(root_id, nodes));
 }
 
-void post_order_printer(int node_id, const std::vector<tree_node>& nodes, std::ostream& out) {
-  if (node_id == -1) {
-    return;
+void print_keys(const std::vector<int>& keys, output_printer& out) {
+  for (const auto& key : keys) {
+    out << key << ' ';
   }
-  post_order_printer(nodes[node_id].left, nodes, out);
-  post_order_printer(nodes[node_id].right, nodes, out);
-  out << nodes[node_id].key << ' ';
 }
 
 int main() {
+  auto input = input_scanner{stdin};
+  auto output = output_printer{stdout};
   auto node_count = size_t{0};
-  std::cin >> node_count;
+  input >> node_count;
   auto nodes = std::vector<tree_node>{};
   nodes.reserve(node_count);
   for (auto node_id = size_t{0}; node_id < node_count; ++node_id) {
     auto node = tree_node{};
-    std::cin >> node.key >> node.left >> node.right;
+    input >> node.key >> node.left >> node.right;
     nodes.emplace_back(node);
   }
-  in_order_printer(0, nodes, std::cout);
-  std::cout << '\n';
-  pre_order_printer(0, nodes, std::cout);
-  std::cout << '\n';
-  post_order_printer(0, nodes, std::cout);
+  const auto orders = traverse_tree(nodes.empty() ? -1 : 0, nodes);
+  print_keys(orders.in_order, output);
+  output << '\n';
+  print_keys(orders.pre_order, output);
+  output << '\n';
+  print_keys(orders.post_order, output);
   return 0;
 };
\ No newline at end of file
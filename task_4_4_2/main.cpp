@@ -1,9 +1,101 @@
+#include <atomic>
 #include <cassert>
+#include <cstdio>
 #include <iostream>
+#include <string>
+#include <thread>
+#include <type_traits>
 #include <vector>
 #include <limits>
+#include <memory>
 #include <algorithm>
 
+// Reader of whitespace separated tokens. The input is read in large blocks and
+// the tokens are parsed straight from the block, bypassing the iostream machinery
+class input_scanner {
+ public:
+  explicit input_scanner(std::FILE* file, size_t block_size = size_t{1} << 16)
+    : file_{file}
+    , block_(block_size)
+    , position_{0}
+    , size_{0}
+  {}
+
+  template <
+    typename Integer,
+    typename std::enable_if<std::is_integral<Integer>::value, int>::type = 0>
+  input_scanner& operator >> (Integer& value) {
+    skip_spaces();
+    const auto negative = (peek() == '-');
+    if (negative) {
+      ++position_;
+    }
+    auto result = Integer{0};
+    for (auto c = peek(); '0' <= c && c <= '9'; c = peek()) {
+      result = static_cast<Integer>(result * 10 + (c - '0'));
+      ++position_;
+    }
+    value = negative ? static_cast<Integer>(-result) : result;
+    return *this;
+  }
+
+  input_scanner& operator >> (char& value) {
+    skip_spaces();
+    const auto c = peek();
+    if (c != end_of_input) {
+      value = static_cast<char>(c);
+      ++position_;
+    }
+    return *this;
+  }
+
+  input_scanner& operator >> (std::string& value) {
+    skip_spaces();
+    value.clear();
+    while (peek() != end_of_input) {
+      auto last = position_;
+      while (last < size_ && !is_space(static_cast<unsigned char>(block_[last]))) {
+        ++last;
+      }
+      value.append(block_.data() + position_, last - position_);
+      position_ = last;
+      if (position_ < size_) {
+        break;
+      }
+    }
+    return *this;
+  }
+
+ private:
+  static constexpr int end_of_input = -1;
+
+  static bool is_space(int c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+  }
+
+  int peek() {
+    if (position_ == size_) {
+      size_ = std::fread(block_.data(), 1, block_.size(), file_);
+      position_ = 0;
+      if (size_ == 0) {
+        return end_of_input;
+      }
+    }
+    return static_cast<unsigned char>(block_[position_]);
+  }
+
+  void skip_spaces() {
+    while (is_space(peek())) {
+      ++position_;
+    }
+  }
+
+  std::FILE* file_;
+  std::vector<char> block_;
+  size_t position_;
+  size_t size_;
+};
+
 struct tree_node {
   int32_t key;
   int left;
@@ -12,49 +104,141 @@ struct tree_node {
 
 struct search_tree_check_result {
   bool is_search_tree;
-  int64_t min_key;
-  int64_t max_key;
+  // the smallest id of a node which breaks the order, -1 for a search tree
+  int offending_node_id;
+};
+
+// subtree under node `node_id` whose keys must be in the range [low, high)
+struct subtree_bounds {
+  int node_id;
+  int64_t low;
+  int64_t high;
 };
 
-search_tree_check_result is_search_tree_impl(int node_id, const std::vector<tree_node>& nodes) {
+// any key in the left subtree is strictly less than the key of the node,
+// any key in the right subtree is greater or equal to it
+subtree_bounds left_bounds(const subtree_bounds& bounds, const tree_node& node) {
+  return subtree_bounds{node.left, bounds.low, static_cast<int64_t>(node.key)};
+}
+
+subtree_bounds right_bounds(const subtree_bounds& bounds, const tree_node& node) {
+  return subtree_bounds{node.right, static_cast<int64_t>(node.key), bounds.high};
+}
+
+bool is_within_bounds(const subtree_bounds& bounds, const tree_node& node) {
+  const auto key = static_cast<int64_t>(node.key);
+  return bounds.low <= key && key < bounds.high;
+}
+
+int min_node_id(int lhs, int rhs) {
+  if (lhs == -1) {
+    return rhs;
+  }
+  if (rhs == -1) {
+    return lhs;
+  }
+  return std::min(lhs, rhs);
+}
+
+// the smallest id of a node in the subtree which is out of its bounds, -1 if there is
+// no such node. The subtree is walked level by level, so its depth is not limited by
+// the call stack. Node ids are arbitrary, but the nodes of a level are known before
+// the level is walked, so they are fetched a few steps ahead of their turn
+int find_offending_node(const subtree_bounds& subtree, const std::vector<tree_node>& nodes) {
+  constexpr auto lookahead = size_t{16};
+  auto offending_node_id = int{-1};
+  auto level = std::vector<subtree_bounds>{subtree};
+  auto next_level = std::vector<subtree_bounds>{};
+  while (!level.empty()) {
+    for (auto position = size_t{0}; position < level.size(); ++position) {
+      if (position + lookahead < level.size()) {
+        __builtin_prefetch(std::addressof(nodes[level[position + lookahead].node_id]));
+      }
+      const auto& bounds = level[position];
+      const auto& node = nodes[bounds.node_id];
+      if (!is_within_bounds(bounds, node)) {
+        offending_node_id = min_node_id(offending_node_id, bounds.node_id);
+      }
+      if (node.left != -1) {
+        next_level.emplace_back(left_bounds(bounds, node));
+      }
+      if (node.right != -1) {
+        next_level.emplace_back(right_bounds(bounds, node));
+      }
+    }
+    level.swap(next_level);
+    next_level.clear();
+  }
+  return offending_node_id;
+}
+
+// check the tree in `threads_count` threads. The top of the tree is checked first,
+// until it falls apart into enough subtrees to keep all threads busy; every thread
+// then takes the next unchecked subtree until none is left
+search_tree_check_result check_search_tree(
+    const std::vector<tree_node>& nodes, size_t threads_count) {
   constexpr auto kMin = std::numeric_limits<int64_t>::min();
   constexpr auto kMax = std::numeric_limits<int64_t>::max();
-  if (node_id == int{-1}) {
-    return search_tree_check_result{true, kMax, kMin};
-  }
-  const auto node_key = static_cast<int64_t>(nodes[node_id].key);
-  const auto left_node_id = nodes[node_id].left;
-  auto left_tree_check_result = is_search_tree_impl(left_node_id, nodes);
-  const auto right_node_id = nodes[node_id].right;
-  auto right_tree_check_result = is_search_tree_impl(right_node_id, nodes);
-  const auto min_key = std::min({
-    node_key, left_tree_check_result.min_key, right_tree_check_result.min_key});
-  const auto max_key = std::max({
-    node_key, left_tree_check_result.max_key, right_tree_check_result.max_key});
-  const auto is_search_tree = bool{
-    (left_tree_check_result.max_key < node_key) &&
-    (node_key <= right_tree_check_result.min_key) &&
-    left_tree_check_result.is_search_tree &&
-    right_tree_check_result.is_search_tree};
-  return search_tree_check_result{is_search_tree, min_key, max_key};
+  if (nodes.empty()) {
+    return search_tree_check_result{true, -1};
+  }
+  threads_count = std::max(threads_count, size_t{1});
+  // several subtrees per thread even out their different sizes
+  const auto subtrees_count = threads_count > 1 ? 8 * threads_count : size_t{1};
+  auto offending_node_id = int{-1};
+  auto subtrees = std::vector<subtree_bounds>{subtree_bounds{0, kMin, kMax}};
+  auto first = size_t{0};
+  while (first < subtrees.size() && subtrees.size() - first < subtrees_count) {
+    const auto bounds = subtrees[first];
+    ++first;
+    const auto& node = nodes[bounds.node_id];
+    if (!is_within_bounds(bounds, node)) {
+      offending_node_id = min_node_id(offending_node_id, bounds.node_id);
+    }
+    if (node.left != -1) {
+      subtrees.emplace_back(left_bounds(bounds, node));
+    }
+    if (node.right != -1) {
+      subtrees.emplace_back(right_bounds(bounds, node));
+    }
+  }
+  auto next_subtree = std::atomic<size_t>{first};
+  auto offending_node_ids = std::vector<int>(threads_count, -1);
+  auto check_subtrees = [&](size_t thread_id) {
+    for (auto subtree = next_subtree++; subtree < subtrees.size(); subtree = next_subtree++) {
+      offending_node_ids[thread_id] = min_node_id(
+        offending_node_ids[thread_id], find_offending_node(subtrees[subtree], nodes));
+    }
+  };
+  auto threads = std::vector<std::thread>{};
+  threads.reserve(threads_count - 1);
+  for (auto thread_id = size_t{1}; thread_id < threads_count; ++thread_id) {
+    threads.emplace_back(check_subtrees, thread_id);
+  }
+  check_subtrees(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (const auto& node_id : offending_node_ids) {
+    offending_node_id = min_node_id(offending_node_id, node_id);
+  }
+  return search_tree_check_result{offending_node_id == -1, offending_node_id};
 }
 
 bool is_search_tree(const std::vector<tree_node>& nodes) {
-  if (nodes.empty()) {
-    return true;
-  }
-  const auto check_result = is_search_tree_impl(0, nodes);
-  return check_result.is_search_tree;
+  const auto threads_count = static_cast<size_t>(std::thread::hardware_concurrency());
+  return check_search_tree(nodes, threads_count).is_search_tree;
 }
 
 int main() {
+  auto input = input_scanner{stdin};
   auto node_count = size_t{0};
-  std::cin >> node_count;
+  input >> node_count;
   auto nodes = std::vector<tree_node>{};
   nodes.reserve(node_count);
   for (auto node_id = size_t{0}; node_id < node_count; ++node_id) {
     auto node = tree_node{};
-    std::cin >> node.key >> node.left >> node.right;
+    input >> node.key >> node.left >> node.right;
     nodes.emplace_back(node);
   }
   if (is_search_tree(nodes)) {
@@ -1,7 +1,362 @@
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+// Reader of whitespace separated tokens. The input is read in large blocks and
+// the tokens are parsed straight from the block, bypassing the iostream machinery
+class input_scanner {
+ public:
+  explicit input_scanner(std::FILE* file, size_t block_size = size_t{1} << 16)
+    : file_{file}
+    , block_(block_size)
+    , position_{0}
+    , size_{0}
+  {}
+
+  template <
+    typename Integer,
+    typename std::enable_if<std::is_integral<Integer>::value, int>::type = 0>
+  input_scanner& operator >> (Integer& value) {
+    skip_spaces();
+    const auto negative = (peek() == '-');
+    if (negative) {
+      ++position_;
+    }
+    auto result = Integer{0};
+    for (auto c = peek(); '0' <= c && c <= '9'; c = peek()) {
+      result = static_cast<Integer>(result * 10 + (c - '0'));
+      ++position_;
+    }
+    value = negative ? static_cast<Integer>(-result) : result;
+    return *this;
+  }
+
+  input_scanner& operator >> (char& value) {
+    skip_spaces();
+    const auto c = peek();
+    if (c != end_of_input) {
+      value = static_cast<char>(c);
+      ++position_;
+    }
+    return *this;
+  }
+
+  input_scanner& operator >> (std::string& value) {
+    skip_spaces();
+    value.clear();
+    while (peek() != end_of_input) {
+      auto last = position_;
+      while (last < size_ && !is_space(static_cast<unsigned char>(block_[last]))) {
+        ++last;
+      }
+      value.append(block_.data() + position_, last - position_);
+      position_ = last;
+      if (position_ < size_) {
+        break;
+      }
+    }
+    return *this;
+  }
+
+  // next byte of the input without consuming it, -1 at the end of the input
+  int next_byte() {
+    return peek();
+  }
+
+  // read the object representation of `value` as it is, without parsing
+  template <typename T>
+  input_scanner& read_binary(T& value) {
+    static_assert(std::is_trivially_copyable<T>::value, "value must be trivially copyable");
+    return read_bytes(reinterpret_cast<char*>(std::addressof(value)), sizeof(T));
+  }
+
+  // read next `count` bytes of the input as they are
+  input_scanner& read_bytes(char* data, size_t count) {
+    while (count > 0 && peek() != end_of_input) {
+      const auto chunk = std::min(count, size_ - position_);
+      std::memcpy(data, block_.data() + position_, chunk);
+      position_ += chunk;
+      data += chunk;
+      count -= chunk;
+    }
+    return *this;
+  }
+
+ private:
+  static constexpr int end_of_input = -1;
+
+  static bool is_space(int c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+  }
+
+  int peek() {
+    if (position_ == size_) {
+      size_ = std::fread(block_.data(), 1, block_.size(), file_);
+      position_ = 0;
+      if (size_ == 0) {
+        return end_of_input;
+      }
+    }
+    return static_cast<unsigned char>(block_[position_]);
+  }
+
+  void skip_spaces() {
+    while (is_space(peek())) {
+      ++position_;
+    }
+  }
+
+  std::FILE* file_;
+  std::vector<char> block_;
+  size_t position_;
+  size_t size_;
+};
+
+// Writer of text output. The text is gathered in a large block which is written out
+// when it is full, on `flush` and on destruction. Integers are formatted by hand
+class output_printer {
+ public:
+  explicit output_printer(std::FILE* file, size_t block_size = size_t{1} << 16)
+    : file_{file}
+    , block_(block_size)
+    , size_{0}
+  {}
+
+  output_printer(const output_printer&) = delete;
+  output_printer& operator = (const output_printer&) = delete;
+
+  ~output_printer() {
+    flush();
+  }
+
+  template <
+    typename Integer,
+    typename std::enable_if<std::is_integral<Integer>::value, int>::type = 0>
+  output_printer& operator << (Integer value) {
+    using unsigned_type = typename std::make_unsigned<Integer>::type;
+    // room for the sign and all the digits
+    reserve(std::numeric_limits<unsigned_type>::digits10 + 2);
+    auto magnitude = static_cast<unsigned_type>(value);
+    if (value < Integer{0}) {
+      block_[size_++] = '-';
+      magnitude = unsigned_type{0} - magnitude;
+    }
+    char digits[std::numeric_limits<unsigned_type>::digits10 + 1];
+    auto count = size_t{0};
+    do {
+      digits[count++] = static_cast<char>('0' + magnitude % 10);
+      magnitude /= 10;
+    } while (magnitude != 0);
+    while (count > 0) {
+      block_[size_++] = digits[--count];
+    }
+    return *this;
+  }
+
+  output_printer& operator << (char value) {
+    reserve(1);
+    block_[size_++] = value;
+    return *this;
+  }
+
+  output_printer& operator << (const char* text) {
+    write(text, std::strlen(text));
+    return *this;
+  }
+
+  output_printer& operator << (const std::string& text) {
+    write(text.data(), text.size());
+    return *this;
+  }
+
+  // write the object representation of `value` as it is, without formatting
+  template <typename T>
+  output_printer& write_binary(const T& value) {
+    static_assert(std::is_trivially_copyable<T>::value, "value must be trivially copyable");
+    write(reinterpret_cast<const char*>(std::addressof(value)), sizeof(T));
+    return *this;
+  }
+
+  // write out everything printed so far
+  void flush() {
+    drain();
+    std::fflush(file_);
+  }
+
+ private:
+  void drain() {
+    std::fwrite(block_.data(), 1, size_, file_);
+    size_ = 0;
+  }
+
+  void reserve(size_t count) {
+    if (block_.size() - size_ < count) {
+      drain();
+    }
+  }
+
+  void write(const char* data, size_t count) {
+    reserve(count);
+    if (count > block_.size()) {
+      std::fwrite(data, 1, count, file_);
+      return;
+    }
+    std::memcpy(block_.data() + size_, data, count);
+    size_ += count;
+  }
+
+  std::FILE* file_;
+  std::vector<char> block_;
+  size_t size_;
+};
+
+// Nodes are linked by raw pointers
+struct pointer_links {
+  template <typename Node>
+  using link = Node*;
+};
+
+// Aggregates are monoids over the values of a subtree: `identity()` is the aggregate
+// of the empty subtree, `of(value)` is the aggregate of a single value and `combine`
+// is associative, the left operand covers the smaller keys
+
+template <typename Value>
+struct sum_aggregate {
+  using value_type = Value;
+
+  static Value identity() {
+    return Value{};
+  }
+
+  static Value of(const Value& value) {
+    return value;
+  }
+
+  static Value combine(const Value& lhs, const Value& rhs) {
+    return lhs + rhs;
+  }
+};
+
+// the sum is taken modulo 2^64, so that it never overflows
+template <typename Value>
+struct sum_of_squares_aggregate {
+  using value_type = uint64_t;
+
+  static uint64_t identity() {
+    return uint64_t{0};
+  }
+
+  static uint64_t of(const Value& value) {
+    return static_cast<uint64_t>(value) * static_cast<uint64_t>(value);
+  }
+
+  static uint64_t combine(uint64_t lhs, uint64_t rhs) {
+    return lhs + rhs;
+  }
+};
+
+template <typename Value>
+struct count_aggregate {
+  using value_type = size_t;
+
+  static size_t identity() {
+    return size_t{0};
+  }
+
+  static size_t of(const Value&) {
+    return size_t{1};
+  }
+
+  static size_t combine(size_t lhs, size_t rhs) {
+    return lhs + rhs;
+  }
+};
+
+template <typename Value>
+struct min_aggregate {
+  using value_type = Value;
+
+  static Value identity() {
+    return std::numeric_limits<Value>::max();
+  }
+
+  static Value of(const Value& value) {
+    return value;
+  }
+
+  static Value combine(const Value& lhs, const Value& rhs) {
+    return std::min(lhs, rhs);
+  }
+};
+
+template <typename Value>
+struct max_aggregate {
+  using value_type = Value;
+
+  static Value identity() {
+    return std::numeric_limits<Value>::lowest();
+  }
+
+  static Value of(const Value& value) {
+    return value;
+  }
+
+  static Value combine(const Value& lhs, const Value& rhs) {
+    return std::max(lhs, rhs);
+  }
+};
+
+// polynomial hash of the values in key order: sum of value_i * x^i modulo p
+struct polynomial_hash {
+  uint64_t hash;
+  uint64_t power;  // x^count
+};
+
+std::ostream& operator << (std::ostream& out, const polynomial_hash& hash) {
+  out << hash.hash;
+  return out;
+}
+
+output_printer& operator << (output_printer& out, const polynomial_hash& hash) {
+  out << hash.hash;
+  return out;
+}
+
+template <typename Value>
+struct polynomial_hash_aggregate {
+  using value_type = polynomial_hash;
+
+  static constexpr auto multiplier = uint64_t{263};
+  static constexpr auto prime = uint64_t{1000000007};
+
+  static polynomial_hash identity() {
+    return polynomial_hash{0, 1};
+  }
+
+  static polynomial_hash of(const Value& value) {
+    const auto residue = static_cast<int64_t>(value) % static_cast<int64_t>(prime);
+    const auto hash = static_cast<uint64_t>(residue < 0 ? residue + prime : residue);
+    return polynomial_hash{hash, multiplier};
+  }
+
+  static polynomial_hash combine(const polynomial_hash& lhs, const polynomial_hash& rhs) {
+    return polynomial_hash{
+      (lhs.hash + rhs.hash * lhs.power) % prime, (lhs.power * rhs.power) % prime};
+  }
+};
+
 // Node of the splay tree
 // Invariants:
 // 1. any key in the left subtree is strictly less than value
@@ -9,12 +364,17 @@
 // 3. no duplicate keys
 
 
-template <typename Value>
+template <
+  typename Value, typename Links = pointer_links, typename Aggregate = sum_aggregate<Value>>
 struct splay_tree_node {
+  using links_type = Links;
+  using link_type = typename Links::template link<splay_tree_node<Value, Links, Aggregate>>;
+  using aggregate_type = Aggregate;
+  using total_type = typename Aggregate::value_type;
 
   splay_tree_node(const Value& value)
     : value{value}
-    , total{value}
+    , total{Aggregate::of(value)}
     , parent{nullptr}
     , left{nullptr}
     , right{nullptr}
@@ -25,7 +385,7 @@ struct splay_tree_node {
     node->parent = nullptr;
     node->left = nullptr;
     node->right = nullptr;
-    node->total = Value{};
+    node->total = Aggregate::identity();
   }
 
   bool is_root() const {
@@ -43,7 +403,7 @@ struct splay_tree_node {
     return !node->is_root() && node->parent->right == node;
   }
 
-  const splay_tree_node<Value>* find_root() const {
+  const splay_tree_node<Value, Links, Aggregate>* find_root() const {
     const auto* node = this;
     if (node == nullptr) {
       return nullptr;
@@ -54,7 +414,7 @@ struct splay_tree_node {
     return node;
   }
 
-  const splay_tree_node<Value>* rightmost_node() const {
+  const splay_tree_node<Value, Links, Aggregate>* rightmost_node() const {
     const auto* node = this;
     while (node->right != nullptr) {
       node = node->right;
@@ -62,12 +422,12 @@ struct splay_tree_node {
     return node;
   }
 
-  splay_tree_node<Value>* rightmost_node() {
+  splay_tree_node<Value, Links, Aggregate>* rightmost_node() {
     const auto* const node = this;
-    return const_cast<splay_tree_node<Value>*>(node->rightmost_node());
+    return const_cast<splay_tree_node<Value, Links, Aggregate>*>(node->rightmost_node());
   }
 
-  const splay_tree_node<Value>* leftmost_node() const {
+  const splay_tree_node<Value, Links, Aggregate>* leftmost_node() const {
     const auto* node = this;
     while (node->left != nullptr) {
       node = node->left;
@@ -75,14 +435,14 @@ struct splay_tree_node {
     return node;
   }
 
-  splay_tree_node<Value>* leftmost_node() {
+  splay_tree_node<Value, Links, Aggregate>* leftmost_node() {
     const auto* const node = this;
-    return const_cast<splay_tree_node<Value>*>(node->leftmost_node());
+    return const_cast<splay_tree_node<Value, Links, Aggregate>*>(node->leftmost_node());
   }
 
-  const splay_tree_node<Value>* next_node() const {
+  const splay_tree_node<Value, Links, Aggregate>* next_node() const {
     const auto* node = this;
-    auto next = static_cast<const splay_tree_node<Value>*>(nullptr);
+    auto next = static_cast<const splay_tree_node<Value, Links, Aggregate>*>(nullptr);
     if (node->right != nullptr) {
       next = node->right;
       while (next->left != nullptr) {
@@ -97,14 +457,14 @@ struct splay_tree_node {
     return next;
   }
 
-  splay_tree_node<Value>* next_node() {
+  splay_tree_node<Value, Links, Aggregate>* next_node() {
     const auto* const node = this;
-    return const_cast<splay_tree_node<Value>*>(node->next_node());
+    return const_cast<splay_tree_node<Value, Links, Aggregate>*>(node->next_node());
   }
 
-  const splay_tree_node<Value>* prev_node() const {
+  const splay_tree_node<Value, Links, Aggregate>* prev_node() const {
     const auto* node = this;
-    auto prev = static_cast<const splay_tree_node<Value>*>(nullptr);
+    auto prev = static_cast<const splay_tree_node<Value, Links, Aggregate>*>(nullptr);
     if (node->left != nullptr) {
       prev = node->left;
       while (prev->right != nullptr) {
@@ -119,117 +479,188 @@ struct splay_tree_node {
     return prev;
   }
 
-  splay_tree_node<Value>* prev_node() {
+  splay_tree_node<Value, Links, Aggregate>* prev_node() {
     const auto* const node = this;
-    return const_cast<splay_tree_node<Value>*>(node->prev_node());
+    return const_cast<splay_tree_node<Value, Links, Aggregate>*>(node->prev_node());
   }
 
   Value value;
-  Value total;
-  splay_tree_node<Value>* parent;
-  splay_tree_node<Value>* left;
-  splay_tree_node<Value>* right;
+  // aggregate of the values in the subtree
+  total_type total;
+  link_type parent;
+  link_type left;
+  link_type right;
 };
 
-template <typename Value>
-std::ostream& operator << (std::ostream& out, const splay_tree_node<Value>& node) {
+template <typename Value, typename Links, typename Aggregate>
+std::ostream& operator << (
+    std::ostream& out, const splay_tree_node<Value, Links, Aggregate>& node) {
   out << "[" << node.value << ", " << node.total << "]";
   return out;
 }
 
-template <typename Value>
-void destroy_node(splay_tree_node<Value>* node) {
+// Node allocator which takes every node from the global heap
+template <typename Node>
+struct heap_node_allocator {
+  using node_type = Node;
+
+  template <typename... Args>
+  Node* create(Args&&... args) {
+    return new Node(std::forward<Args>(args)...);
+  }
+
+  void destroy(Node* node) noexcept {
+    delete node;
+  }
+};
+
+// Storage of nodes of the same type. Nodes are carved out of contiguous slabs,
+// destroyed nodes are kept in the free list and reused by the next allocations.
+// All slabs are released at once by `reset` or by the destructor, nodes which are
+// still alive at that moment are dropped without running their destructors
+template <typename Node>
+class node_pool {
+ public:
+  explicit node_pool(size_t slab_size = size_t{1024})
+    : slabs_{}
+    , slab_size_{slab_size}
+    , used_{slab_size}
+    , free_list_{nullptr}
+  {
+    assert(slab_size_ > 0);
+  }
+
+  node_pool(const node_pool&) = delete;
+  node_pool& operator = (const node_pool&) = delete;
+
+  template <typename... Args>
+  Node* create(Args&&... args) {
+    auto place = static_cast<void*>(nullptr);
+    if (free_list_ != nullptr) {
+      place = free_list_;
+      free_list_ = free_list_->next;
+    } else {
+      if (used_ == slab_size_) {
+        grow();
+      }
+      place = std::addressof(slabs_.back()[used_]);
+      ++used_;
+    }
+    return ::new (place) Node(std::forward<Args>(args)...);
+  }
+
+  void destroy(Node* node) noexcept {
+    assert(node != nullptr);
+    node->~Node();
+    auto cell = ::new (static_cast<void*>(node)) free_cell;
+    cell->next = free_list_;
+    free_list_ = cell;
+  }
+
+  // release all slabs at once
+  void reset() noexcept {
+    slabs_.clear();
+    used_ = slab_size_;
+    free_list_ = nullptr;
+  }
+
+ private:
+  using cell = typename std::aligned_storage<sizeof(Node), alignof(Node)>::type;
+
+  struct free_cell {
+    free_cell* next;
+  };
+
+  static_assert(sizeof(free_cell) <= sizeof(Node), "node is too small for the free list");
+
+  void grow() {
+    // slabs double in size so that the number of slabs stays logarithmic
+    if (!slabs_.empty()) {
+      slab_size_ *= 2;
+    }
+    slabs_.emplace_back(new cell[slab_size_]);
+    used_ = size_t{0};
+  }
+
+  std::vector<std::unique_ptr<cell[]>> slabs_;
+  size_t slab_size_;
+  size_t used_;
+  free_cell* free_list_;
+};
+
+// Node allocator which takes nodes from the shared `node_pool`. Trees which exchange
+// nodes (split, merge) must use the same pool
+template <typename Node>
+struct pool_node_allocator {
+  using node_type = Node;
+
+  explicit pool_node_allocator(node_pool<Node>* pool = nullptr) noexcept
+    : pool{pool}
+  {}
+
+  template <typename... Args>
+  Node* create(Args&&... args) {
+    assert(pool != nullptr);
+    return pool->create(std::forward<Args>(args)...);
+  }
+
+  void destroy(Node* node) noexcept {
+    assert(pool != nullptr);
+    pool->destroy(node);
+  }
+
+  node_pool<Node>* pool;
+};
+
+template <typename Value, typename Links, typename Aggregate, typename NodeAllocator>
+void destroy_node(splay_tree_node<Value, Links, Aggregate>* node, NodeAllocator& allocator) {
   assert(node != nullptr);
-  delete node;
+  allocator.destroy(node);
 }
 
-template <typename Value>
-splay_tree_node<Value>* create_node(const Value& value) {
-  return new splay_tree_node<Value>(value);
+template <typename Value, typename NodeAllocator>
+typename NodeAllocator::node_type* create_node(const Value& value, NodeAllocator& allocator) {
+  return allocator.create(value);
 }
 
-template <typename Value>
-void print_subtree(std::ostream& out, const splay_tree_node<Value>* root) {
+template <typename Value, typename Links, typename Aggregate>
+void print_subtree(std::ostream& out, const splay_tree_node<Value, Links, Aggregate>* root) {
   out << "(";
   if (root != nullptr) {
-    print_subtree(out, root->left);
+    print_subtree<Value, Links, Aggregate>(out, root->left);
     out << *root;
-    print_subtree(out, root->right);
+    print_subtree<Value, Links, Aggregate>(out, root->right);
   }
   out << ")";
 }
 
 // destroy subtree under the node `root`
-template <typename Value>
-void destroy_substree(splay_tree_node<Value>* root) {
+template <typename Value, typename Links, typename Aggregate, typename NodeAllocator>
+void destroy_substree(splay_tree_node<Value, Links, Aggregate>* root, NodeAllocator& allocator) {
   if (root == nullptr) {
     return;
   }
-  destroy_substree(root->left);
+  destroy_substree<Value, Links, Aggregate>(root->left, allocator);
   root->left = nullptr;
-  destroy_substree(root->right);
+  destroy_substree<Value, Links, Aggregate>(root->right, allocator);
   root->right = nullptr;
   root->parent = nullptr;
-  destroy_node(root);
-}
-
-template <typename Value>
-void update_total(splay_tree_node<Value>* node) {
-  if (node != nullptr) {
-    node->total = node->value;
-    node->total += (node->left != nullptr ? node->left->total : Value{});
-    node->total += (node->right != nullptr ? node->right->total : Value{});
-  }
+  destroy_node(root, allocator);
 }
 
-// insert new node `new_node` to subtree at root `root`, without rebalancing
-template <typename Key, typename Value, typename KeyExtractor, typename KeyComparator>
-splay_tree_node<Value>* insert_node(
-    splay_tree_node<Value>* root,
-    const Value& value,
-    const KeyExtractor& extractor,
-    const KeyComparator& comparator) {
-  assert(root != nullptr);
-  auto node = static_cast<splay_tree_node<Value>*>(nullptr);
-  while (root != nullptr) {
-    node = root;
-    if (comparator(extractor(value), extractor(root->value))) {
-      if (root->left == nullptr) {
-        auto new_node = create_node(value);
-        root->left = new_node;
-        new_node->parent = root;
-        node = new_node;
-        break;
-      } else {
-        root = root->left;
-      }
-    } else if (comparator(extractor(root->value), extractor(value))) {
-      if (root->right == nullptr) {
-        auto new_node = create_node(value);
-        root->right = new_node;
-        new_node->parent = root;
-        node = new_node;
-        break;
-      } else {
-        root = root->right;
-      }
-    } else {
-      node = nullptr;
-      break;
-    }
-  }
+template <typename Value, typename Links, typename Aggregate>
+void update_total(splay_tree_node<Value, Links, Aggregate>* node) {
   if (node != nullptr) {
-    auto parent = node->parent;
-    while (parent != nullptr) {
-      parent->total += node->value;
-      parent = parent->parent;
-    }
+    node->total = Aggregate::combine(
+      Aggregate::combine(
+        node->left != nullptr ? node->left->total : Aggregate::identity(),
+        Aggregate::of(node->value)),
+      node->right != nullptr ? node->right->total : Aggregate::identity());
   }
-  return node;
 }
 
-template <typename Value>
-void left_rotate_node(splay_tree_node<Value>* node) {
+template <typename Value, typename Links, typename Aggregate>
+void left_rotate_node(splay_tree_node<Value, Links, Aggregate>* node) {
   /* u is node, a is parent, B is branch, p is granny
   *
   *      p             p
@@ -243,9 +674,9 @@ void left_rotate_node(splay_tree_node<Value>* node) {
 
   assert(node != nullptr);
   assert(node->parent != nullptr);
-  auto parent = node->parent;
-  auto branch = node->right;
-  auto granny = parent->parent;
+  auto parent = static_cast<splay_tree_node<Value, Links, Aggregate>*>(node->parent);
+  auto branch = static_cast<splay_tree_node<Value, Links, Aggregate>*>(node->right);
+  auto granny = static_cast<splay_tree_node<Value, Links, Aggregate>*>(parent->parent);
   if (granny != nullptr) {
     if (parent->is_left_child()) {
       granny->left = node;
@@ -266,8 +697,8 @@ void left_rotate_node(splay_tree_node<Value>* node) {
   update_total(node);
 }
 
-template <typename Value>
-void right_rotate_node(splay_tree_node<Value>* node) {
+template <typename Value, typename Links, typename Aggregate>
+void right_rotate_node(splay_tree_node<Value, Links, Aggregate>* node) {
   /* u is node, a is parent, B is branch, p is granny
   *
   *      p             p
@@ -281,9 +712,9 @@ void right_rotate_node(splay_tree_node<Value>* node) {
 
   assert(node != nullptr);
   assert(node->parent != nullptr);
-  auto parent = node->parent;
-  auto branch = node->left;
-  auto granny = parent->parent;
+  auto parent = static_cast<splay_tree_node<Value, Links, Aggregate>*>(node->parent);
+  auto branch = static_cast<splay_tree_node<Value, Links, Aggregate>*>(node->left);
+  auto granny = static_cast<splay_tree_node<Value, Links, Aggregate>*>(parent->parent);
   if (granny != nullptr) {
     if (parent->is_left_child()) {
       granny->left = node;
@@ -304,8 +735,8 @@ void right_rotate_node(splay_tree_node<Value>* node) {
   update_total(node);
 }
 
-template <typename Value>
-void rotate_node(splay_tree_node<Value>* node) {
+template <typename Value, typename Links, typename Aggregate>
+void rotate_node(splay_tree_node<Value, Links, Aggregate>* node) {
   if (node->is_left_child()) {
     left_rotate_node(node);
   } else if (node->is_right_child()) {
@@ -316,8 +747,8 @@ void rotate_node(splay_tree_node<Value>* node) {
 }
 
 // splay node `node`
-template <typename Value>
-void splay_node(splay_tree_node<Value>* node) {
+template <typename Value, typename Links, typename Aggregate>
+void splay_node(splay_tree_node<Value, Links, Aggregate>* node) {
   /* ------------------------------------------------------------------------------------
   * zig_zig
   *        p                                                                p
@@ -375,7 +806,7 @@ void splay_node(splay_tree_node<Value>* node) {
         rotate_node(node);
         rotate_node(node);
       } else {
-        rotate_node(node->parent);
+        rotate_node<Value, Links, Aggregate>(node->parent);
         rotate_node(node);
       }
     }
@@ -384,13 +815,15 @@ void splay_node(splay_tree_node<Value>* node) {
 
 // find node with key `key` in the subtree under node `root`. If such node doesn't exist
 // return the last node during this search
-template <typename Key, typename Value, typename KeyExtractor, typename KeyComparator>
-splay_tree_node<Value>* find_candidate(
-    splay_tree_node<Value>* root,
+template <
+  typename Key, typename Value, typename Links, typename Aggregate, typename KeyExtractor,
+  typename KeyComparator>
+splay_tree_node<Value, Links, Aggregate>* find_candidate(
+    splay_tree_node<Value, Links, Aggregate>* root,
     const Key& key,
     const KeyExtractor& extractor,
     const KeyComparator& comparator) {
-  auto node = static_cast<splay_tree_node<Value>*>(nullptr);
+  auto node = static_cast<splay_tree_node<Value, Links, Aggregate>*>(nullptr);
   if (root != nullptr) {
     node = root->parent;
     while (root != nullptr) {
@@ -408,56 +841,241 @@ splay_tree_node<Value>* find_candidate(
   return node;
 }
 
-template <typename Key, typename Value, typename KeyExtractor, typename KeyComparator>
-splay_tree_node<Value>* lower_bound(
-    splay_tree_node<Value>* root,
-    const Key& key,
-    const KeyExtractor& extractor,
-    const KeyComparator& comparator) {
-  auto node = static_cast<splay_tree_node<Value>*>(nullptr);
-  while (root != nullptr) {
-    if (!comparator(extractor(root->value), key)) {
-      node = root;
-      root = root->left;
-    } else {
-      root = root->right;
+// Navigators steer the descent from the root: `direction(node)` is negative to go
+// to the left child, positive to go to the right child and zero to stop at `node`.
+// `descend(node, direction)` is called when the descent actually leaves `node`
+
+// navigate to the node with key `key`, or to the last node on the search path
+template <typename Key, typename KeyExtractor, typename KeyComparator>
+struct key_navigator {
+  template <typename Node>
+  int direction(const Node* node) const noexcept {
+    if (comparator(key, extractor(node->value))) {
+      return -1;
+    } else if (comparator(extractor(node->value), key)) {
+      return 1;
     }
+    return 0;
   }
-  return node;
-}
 
-template <typename Key, typename Value, typename KeyExtractor, typename KeyComparator>
-splay_tree_node<Value>* upper_bound(
-    splay_tree_node<Value>* root,
-    const Key& key,
-    const KeyExtractor& extractor,
-    const KeyComparator& comparator) {
-  auto node = static_cast<splay_tree_node<Value>*>(nullptr);
-  while (root != nullptr) {
-    if (comparator(key, extractor(root->value))) {
-      node = root;
-      root = root->left;
-    } else {
-      root = root->right;
+  template <typename Node>
+  void descend(const Node*, int) noexcept {}
+
+  const Key& key;
+  const KeyExtractor& extractor;
+  const KeyComparator& comparator;
+};
+
+// navigate to the leftmost (`Direction` is -1) or to the rightmost (`Direction` is 1) node
+template <int Direction>
+struct edge_navigator {
+  template <typename Node>
+  int direction(const Node*) const noexcept {
+    return Direction;
+  }
+
+  template <typename Node>
+  void descend(const Node*, int) noexcept {}
+};
+
+using leftmost_navigator = edge_navigator<-1>;
+using rightmost_navigator = edge_navigator<1>;
+
+// descend from `root` as `navigator` says, return the last visited node
+template <typename Value, typename Links, typename Aggregate, typename Navigator>
+splay_tree_node<Value, Links, Aggregate>* descend_subtree(
+    splay_tree_node<Value, Links, Aggregate>* root, Navigator& navigator) noexcept {
+  auto node = root;
+  while (node != nullptr) {
+    const auto direction = navigator.direction(node);
+    auto child = static_cast<splay_tree_node<Value, Links, Aggregate>*>(nullptr);
+    if (direction < 0) {
+      child = node->left;
+    } else if (direction > 0) {
+      child = node->right;
+    }
+    if (child == nullptr) {
+      break;
     }
+    navigator.descend(node, direction);
+    node = child;
   }
   return node;
 }
 
-template <typename Value>
-splay_tree_node<Value>* copy_subtree(const splay_tree_node<Value>* root) {
+// splay the node found by `navigator` in the subtree under `root`, single pass.
+// On the way down the passed nodes are hung onto the left tree (nodes before the
+// found one) and onto the right tree (nodes after it); two steps in the same
+// direction are preceded by a rotation as in zig-zig. At the end the left and the
+// right trees become the subtrees of the found node. Returns the new root
+template <typename Value, typename Links, typename Aggregate, typename Navigator>
+splay_tree_node<Value, Links, Aggregate>* splay_top_down(
+    splay_tree_node<Value, Links, Aggregate>* root, Navigator& navigator) noexcept {
+  assert(root == nullptr || root->parent == nullptr);
   if (root == nullptr) {
     return nullptr;
   }
-  auto node = create_node(root->value);
-  assert(node != nullptr);
-  node->total = root->total;
-  node->left = copy_subtree(root->left);
-  if (node->left != nullptr) {
-    node->left->parent = node;
+  auto left_root = static_cast<splay_tree_node<Value, Links, Aggregate>*>(nullptr);
+  auto left_max = static_cast<splay_tree_node<Value, Links, Aggregate>*>(nullptr);
+  auto right_root = static_cast<splay_tree_node<Value, Links, Aggregate>*>(nullptr);
+  auto right_min = static_cast<splay_tree_node<Value, Links, Aggregate>*>(nullptr);
+  auto node = root;
+  while (true) {
+    const auto direction = navigator.direction(node);
+    if (direction < 0) {
+      auto child = static_cast<splay_tree_node<Value, Links, Aggregate>*>(node->left);
+      if (child == nullptr) {
+        break;
+      }
+      navigator.descend(node, direction);
+      if (child->left != nullptr && navigator.direction(child) < 0) {
+        // zig-zig, rotate `child` over `node`
+        navigator.descend(child, -1);
+        node->left = child->right;
+        if (child->right != nullptr) {
+          child->right->parent = node;
+        }
+        child->right = node;
+        node->parent = child;
+        update_total(node);
+        node = child;
+        child = node->left;
+      }
+      // `node` and its right subtree go to the right tree
+      if (right_min != nullptr) {
+        right_min->left = node;
+        node->parent = right_min;
+      } else {
+        right_root = node;
+        node->parent = nullptr;
+      }
+      right_min = node;
+      node = child;
+    } else if (direction > 0) {
+      auto child = static_cast<splay_tree_node<Value, Links, Aggregate>*>(node->right);
+      if (child == nullptr) {
+        break;
+      }
+      navigator.descend(node, direction);
+      if (child->right != nullptr && navigator.direction(child) > 0) {
+        // zag-zag, rotate `child` over `node`
+        navigator.descend(child, 1);
+        node->right = child->left;
+        if (child->left != nullptr) {
+          child->left->parent = node;
+        }
+        child->left = node;
+        node->parent = child;
+        update_total(node);
+        node = child;
+        child = node->right;
+      }
+      // `node` and its left subtree go to the left tree
+      if (left_max != nullptr) {
+        left_max->right = node;
+        node->parent = left_max;
+      } else {
+        left_root = node;
+        node->parent = nullptr;
+      }
+      left_max = node;
+      node = child;
+    } else {
+      break;
+    }
   }
-  node->right = copy_subtree(root->right);
-  if (node->right != nullptr) {
+  if (left_max != nullptr) {
+    left_max->right = node->left;
+    if (node->left != nullptr) {
+      node->left->parent = left_max;
+    }
+    node->left = left_root;
+    left_root->parent = node;
+  }
+  if (right_min != nullptr) {
+    right_min->left = node->right;
+    if (node->right != nullptr) {
+      node->right->parent = right_min;
+    }
+    node->right = right_root;
+    right_root->parent = node;
+  }
+  node->parent = nullptr;
+  // only the inner spines of the left and the right trees got new children
+  for (auto spine = left_max; spine != nullptr && spine != node; spine = spine->parent) {
+    update_total(spine);
+  }
+  for (auto spine = right_min; spine != nullptr && spine != node; spine = spine->parent) {
+    update_total(spine);
+  }
+  update_total(node);
+  return node;
+}
+
+// Splaying strategies, `splay` brings the node found by the navigator to the root
+// and returns it.
+// `bottom_up_splay` descends to the node and rotates it back up along parent links.
+// `top_down_splay` rotates while descending, in a single pass over the path
+struct bottom_up_splay {
+  template <typename Value, typename Links, typename Aggregate, typename Navigator>
+  static splay_tree_node<Value, Links, Aggregate>* splay(
+      splay_tree_node<Value, Links, Aggregate>* root, Navigator navigator) noexcept {
+    auto node = descend_subtree(root, navigator);
+    if (node != nullptr) {
+      splay_node(node);
+    }
+    return node;
+  }
+};
+
+struct top_down_splay {
+  template <typename Value, typename Links, typename Aggregate, typename Navigator>
+  static splay_tree_node<Value, Links, Aggregate>* splay(
+      splay_tree_node<Value, Links, Aggregate>* root, Navigator navigator) noexcept {
+    return splay_top_down(root, navigator);
+  }
+};
+
+// build a perfectly balanced subtree out of `count` values starting at `first`,
+// the values keep their order, `first` is advanced past the used values
+template <typename Iter, typename NodeAllocator>
+typename NodeAllocator::node_type* build_subtree(
+    Iter& first, size_t count, NodeAllocator& allocator) {
+  if (count == 0) {
+    return nullptr;
+  }
+  const auto left_count = count / 2;
+  auto left = build_subtree(first, left_count, allocator);
+  auto node = create_node(*first, allocator);
+  ++first;
+  auto right = build_subtree(first, count - left_count - 1, allocator);
+  node->left = left;
+  if (left != nullptr) {
+    left->parent = node;
+  }
+  node->right = right;
+  if (right != nullptr) {
+    right->parent = node;
+  }
+  update_total(node);
+  return node;
+}
+
+template <typename Value, typename Links, typename Aggregate, typename NodeAllocator>
+splay_tree_node<Value, Links, Aggregate>* copy_subtree(
+    const splay_tree_node<Value, Links, Aggregate>* root, NodeAllocator& allocator) {
+  if (root == nullptr) {
+    return nullptr;
+  }
+  auto node = create_node(root->value, allocator);
+  assert(node != nullptr);
+  node->total = root->total;
+  node->left = copy_subtree<Value, Links, Aggregate>(root->left, allocator);
+  if (node->left != nullptr) {
+    node->left->parent = node;
+  }
+  node->right = copy_subtree<Value, Links, Aggregate>(root->right, allocator);
+  if (node->right != nullptr) {
     node->right->parent = node;
   }
   return node;
@@ -465,8 +1083,9 @@ splay_tree_node<Value>* copy_subtree(const splay_tree_node<Value>* root) {
 
 // merge two subtrees under node `lhs` and `rhs`
 // all keys in subtree of `lhs` must be strictly less then any key in subtree of `rhs`
-template <typename Value>
-splay_tree_node<Value>* merge_subtrees(splay_tree_node<Value>* lhs, splay_tree_node<Value>* rhs) {
+template <typename Value, typename Links, typename Aggregate>
+splay_tree_node<Value, Links, Aggregate>* merge_subtrees(
+    splay_tree_node<Value, Links, Aggregate>* lhs, splay_tree_node<Value, Links, Aggregate>* rhs) {
   assert(lhs == nullptr || lhs->parent == nullptr);
   assert(rhs == nullptr || rhs->parent == nullptr);
   if (lhs == nullptr) {
@@ -480,22 +1099,47 @@ splay_tree_node<Value>* merge_subtrees(splay_tree_node<Value>* lhs, splay_tree_n
   assert(max_lhs->right == nullptr);
   max_lhs->right = rhs;
   rhs->parent = max_lhs;
-  max_lhs->total += rhs->total;
+  max_lhs->total = Aggregate::combine(max_lhs->total, rhs->total);
   return max_lhs;
 }
 
+// split root node onto two trees `left` and `right` such that
+// any key in `left` is less than or equal to `node->value`
+// any key in `right` is greater than `node->value`
+template <typename Value, typename Links, typename Aggregate>
+std::pair<splay_tree_node<Value, Links, Aggregate>*, splay_tree_node<Value, Links, Aggregate>*>
+split_root_left(splay_tree_node<Value, Links, Aggregate>* root) {
+  assert(root != nullptr);
+  assert(root->parent == nullptr);
+  auto left = static_cast<splay_tree_node<Value, Links, Aggregate>*>(nullptr);
+  auto right = static_cast<splay_tree_node<Value, Links, Aggregate>*>(nullptr);
+  left = root;
+  right = root->right;
+  // forget relatives
+  left->right = nullptr;
+  left->parent = nullptr;
+  if (right != nullptr) {
+    right->parent = nullptr;
+    update_total(left);
+  }
+  return std::make_pair(left, right);
+}
+
 // split root node onto two trees `left` and `right` such that
 // any key in `left` is less than `node->value`
 // any key in `right` is greater or equal to `node->value`
-template <typename Value, typename KeyExtractor, typename KeyComparator>
-std::pair<splay_tree_node<Value>*, splay_tree_node<Value>*> split_root(
-    splay_tree_node<Value>* root,
+template <
+  typename Value, typename Links, typename Aggregate, typename KeyExtractor,
+  typename KeyComparator>
+std::pair<splay_tree_node<Value, Links, Aggregate>*, splay_tree_node<Value, Links, Aggregate>*>
+split_root(
+    splay_tree_node<Value, Links, Aggregate>* root,
     const KeyExtractor& extractor,
     const KeyComparator& comparator) {
   assert(root != nullptr);
   assert(root->parent == nullptr);
-  auto left = static_cast<splay_tree_node<Value>*>(nullptr);
-  auto right = static_cast<splay_tree_node<Value>*>(nullptr);
+  auto left = static_cast<splay_tree_node<Value, Links, Aggregate>*>(nullptr);
+  auto right = static_cast<splay_tree_node<Value, Links, Aggregate>*>(nullptr);
   left = root->left;
   right = root;
   // forget relatives
@@ -503,7 +1147,7 @@ std::pair<splay_tree_node<Value>*, splay_tree_node<Value>*> split_root(
   right->parent = nullptr;
   if (left != nullptr) {
     left->parent = nullptr;
-    right->total -= left->total;
+    update_total(right);
   }
   return std::make_pair(left, right);
 }
@@ -511,20 +1155,25 @@ std::pair<splay_tree_node<Value>*, splay_tree_node<Value>*> split_root(
 // split tree under node `root` onto two trees `left` and `right` such that
 // any key in `left` is less than `key`
 // any key in `right` is greater or equal to `bound->value`
-template <typename Key, typename Value, typename KeyExtractor, typename KeyComparator>
-std::pair<splay_tree_node<Value>*, splay_tree_node<Value>*> split_lower_impl(
-    splay_tree_node<Value>* root,
+template <
+  typename Key, typename Value, typename Links, typename Aggregate, typename KeyExtractor,
+  typename KeyComparator, typename SplayPolicy>
+std::pair<splay_tree_node<Value, Links, Aggregate>*, splay_tree_node<Value, Links, Aggregate>*>
+split_lower_impl(
+    splay_tree_node<Value, Links, Aggregate>* root,
     const Key& key,
     const KeyExtractor& extractor,
-    const KeyComparator& comparator) {
-  auto split = std::pair<splay_tree_node<Value>*, splay_tree_node<Value>*>{nullptr, nullptr};
+    const KeyComparator& comparator,
+    const SplayPolicy& policy) {
+  auto split = std::pair<
+    splay_tree_node<Value, Links, Aggregate>*, splay_tree_node<Value, Links, Aggregate>*>{};
   if (root != nullptr) {
-    auto bound = lower_bound(root, key, extractor, comparator);
-    if (bound != nullptr) {
-      splay_node(bound);
-      split = split_root(bound, extractor, comparator);
+    auto navigator = key_navigator<Key, KeyExtractor, KeyComparator>{key, extractor, comparator};
+    root = policy.splay(root, navigator);
+    if (comparator(extractor(root->value), key)) {
+      split = split_root_left(root);
     } else {
-      split = std::make_pair(root, nullptr);
+      split = split_root(root, extractor, comparator);
     }
   }
   return split;
@@ -533,66 +1182,202 @@ std::pair<splay_tree_node<Value>*, splay_tree_node<Value>*> split_lower_impl(
 // split tree under node `root` onto two trees `left` and `right` such that
 // any key in `left` is less than or equal to `key`
 // any key in `right` is greater than`bound->value`
-template <typename Key, typename Value, typename KeyExtractor, typename KeyComparator>
-std::pair<splay_tree_node<Value>*, splay_tree_node<Value>*> split_upper_impl(
-    splay_tree_node<Value>* root,
+template <
+  typename Key, typename Value, typename Links, typename Aggregate, typename KeyExtractor,
+  typename KeyComparator, typename SplayPolicy>
+std::pair<splay_tree_node<Value, Links, Aggregate>*, splay_tree_node<Value, Links, Aggregate>*>
+split_upper_impl(
+    splay_tree_node<Value, Links, Aggregate>* root,
     const Key& key,
     const KeyExtractor& extractor,
-    const KeyComparator& comparator) {
-  auto split = std::pair<splay_tree_node<Value>*, splay_tree_node<Value>*>{};
+    const KeyComparator& comparator,
+    const SplayPolicy& policy) {
+  auto split = std::pair<
+    splay_tree_node<Value, Links, Aggregate>*, splay_tree_node<Value, Links, Aggregate>*>{};
   if (root != nullptr) {
-    auto bound = upper_bound(root, key, extractor, comparator);
-    if (bound != nullptr) {
-      splay_node(bound);
-      split = split_root(bound, extractor, comparator);
+    auto navigator = key_navigator<Key, KeyExtractor, KeyComparator>{key, extractor, comparator};
+    root = policy.splay(root, navigator);
+    if (comparator(key, extractor(root->value))) {
+      split = split_root(root, extractor, comparator);
     } else {
-      split = std::make_pair(root, nullptr);
+      split = split_root_left(root);
     }
   }
   return split;
 }
 
-template <typename Key, typename Value, typename KeyExtractor, typename KeyComparator>
+// raw address of the node a link refers to
+template <typename Node>
+const Node* link_target(const Node* link) noexcept {
+  return link;
+}
+
+template <typename Node>
+const Node* link_target(const std::shared_ptr<const Node>& link) noexcept {
+  return link.get();
+}
+
+// aggregate of the values with keys greater or equal to `low` in the subtree `root`
+template <typename Key, typename Node, typename KeyExtractor, typename KeyComparator>
+typename Node::total_type aggregate_suffix(
+    const Node* root,
+    const Key& low,
+    const KeyExtractor& extractor,
+    const KeyComparator& comparator) {
+  using aggregate_type = typename Node::aggregate_type;
+  auto total = aggregate_type::identity();
+  auto node = root;
+  while (node != nullptr) {
+    if (comparator(extractor(node->value), low)) {
+      node = link_target(node->right);
+    } else {
+      // `node` and its right subtree precede everything collected so far
+      const auto right_total = (
+        node->right != nullptr ? node->right->total : aggregate_type::identity());
+      total = aggregate_type::combine(
+        aggregate_type::combine(aggregate_type::of(node->value), right_total), total);
+      node = link_target(node->left);
+    }
+  }
+  return total;
+}
+
+// aggregate of the values with keys less or equal to `high` in the subtree `root`
+template <typename Key, typename Node, typename KeyExtractor, typename KeyComparator>
+typename Node::total_type aggregate_prefix(
+    const Node* root,
+    const Key& high,
+    const KeyExtractor& extractor,
+    const KeyComparator& comparator) {
+  using aggregate_type = typename Node::aggregate_type;
+  auto total = aggregate_type::identity();
+  auto node = root;
+  while (node != nullptr) {
+    if (comparator(high, extractor(node->value))) {
+      node = link_target(node->left);
+    } else {
+      // `node` and its left subtree follow everything collected so far
+      const auto left_total = (
+        node->left != nullptr ? node->left->total : aggregate_type::identity());
+      total = aggregate_type::combine(
+        total, aggregate_type::combine(left_total, aggregate_type::of(node->value)));
+      node = link_target(node->right);
+    }
+  }
+  return total;
+}
+
+// aggregate of the values with keys in the range [low, high] in the subtree `root`,
+// the subtree is only read
+template <typename Key, typename Node, typename KeyExtractor, typename KeyComparator>
+typename Node::total_type aggregate_range(
+    const Node* root,
+    const Key& low,
+    const Key& high,
+    const KeyExtractor& extractor,
+    const KeyComparator& comparator) {
+  using aggregate_type = typename Node::aggregate_type;
+  auto node = root;
+  // descend to the topmost node inside the range, the range is split there
+  while (node != nullptr) {
+    if (comparator(extractor(node->value), low)) {
+      node = link_target(node->right);
+    } else if (comparator(high, extractor(node->value))) {
+      node = link_target(node->left);
+    } else {
+      return aggregate_type::combine(
+        aggregate_type::combine(
+          aggregate_suffix(link_target(node->left), low, extractor, comparator),
+          aggregate_type::of(node->value)),
+        aggregate_prefix(link_target(node->right), high, extractor, comparator));
+    }
+  }
+  return aggregate_type::identity();
+}
+
+// tag for the constructors which take a range sorted by key without duplicate keys
+struct sorted_unique_t {};
+
+constexpr auto sorted_unique = sorted_unique_t{};
+
+template <
+  typename Key, typename Value, typename KeyExtractor, typename KeyComparator,
+  typename NodeAllocator = heap_node_allocator<splay_tree_node<Value>>,
+  typename SplayPolicy = bottom_up_splay>
 struct splay_tree {
-  explicit splay_tree(const KeyComparator& comparator = KeyComparator{})
+  using self = splay_tree<Key, Value, KeyExtractor, KeyComparator, NodeAllocator, SplayPolicy>;
+  // the node layout is chosen by the allocator, the splaying strategy is
+  // `bottom_up_splay` or `top_down_splay`
+  using node_type = typename NodeAllocator::node_type;
+  using links_type = typename node_type::links_type;
+  using aggregate_type = typename node_type::aggregate_type;
+  using total_type = typename node_type::total_type;
+
+  explicit splay_tree(
+      const KeyComparator& comparator = KeyComparator{},
+      const NodeAllocator& allocator = NodeAllocator{})
     : root{nullptr}
     , extractor{}
     , comparator{comparator}
+    , allocator{allocator}
   {}
 
-  splay_tree(std::initializer_list<Value> init, const KeyComparator& comparator = KeyComparator{})
-    : splay_tree{std::begin(init), std::end(init), comparator}
+  splay_tree(
+      std::initializer_list<Value> init,
+      const KeyComparator& comparator = KeyComparator{},
+      const NodeAllocator& allocator = NodeAllocator{})
+    : splay_tree{std::begin(init), std::end(init), comparator, allocator}
   {}
 
   template <typename Iter>
-  splay_tree(Iter first, Iter last, const KeyComparator& comparator = KeyComparator{})
-    : splay_tree(comparator) {
+  splay_tree(
+      Iter first,
+      Iter last,
+      const KeyComparator& comparator = KeyComparator{},
+      const NodeAllocator& allocator = NodeAllocator{})
+    : splay_tree(comparator, allocator) {
     for (auto it = first; it != last; ++it) {
       this->insert(*it);
     }
   }
 
-  splay_tree(const splay_tree& other)
-    : splay_tree{} {
-    this->root = copy_subtree(other.root);
+  // the range must be sorted by key and free of duplicate keys, the tree is built
+  // balanced in linear time
+  template <typename Iter>
+  splay_tree(
+      sorted_unique_t,
+      Iter first,
+      Iter last,
+      const KeyComparator& comparator = KeyComparator{},
+      const NodeAllocator& allocator = NodeAllocator{})
+    : splay_tree(comparator, allocator) {
+    auto* const tree = this;
+    assert(std::adjacent_find(first, last, [tree](const Value& lhs, const Value& rhs) {
+      return !tree->comparator(tree->extractor(lhs), tree->extractor(rhs));
+    }) == last);
+    const auto count = static_cast<size_t>(std::distance(first, last));
+    tree->root = build_subtree(first, count, tree->allocator);
+  }
+
+  splay_tree(const self& other)
+    : splay_tree{other.comparator, other.allocator} {
+    this->root = copy_subtree(other.root, this->allocator);
   }
 
-  splay_tree(splay_tree<Key, Value, KeyExtractor, KeyComparator>&& other)
-    : splay_tree{} {
+  splay_tree(self&& other)
+    : splay_tree{other.comparator, other.allocator} {
     this->swap(other);
   }
 
-  splay_tree<Key, Value, KeyExtractor, KeyComparator>& operator = (
-      const splay_tree<Key, Value, KeyExtractor, KeyComparator>& other) {
+  self& operator = (const self& other) {
     if (this != std::addressof(other)) {
-      auto temp = splay_tree<Key, Value, KeyExtractor, KeyComparator>{other};
+      auto temp = self{other};
       this->swap(temp);
     }
     return *this;
   }
 
-  splay_tree<Key, Value, KeyExtractor, KeyComparator>& operator = (
-     splay_tree<Key, Value, KeyExtractor, KeyComparator>&& other) {
+  self& operator = (self&& other) {
     this->swap(other);
     return *this;
   }
@@ -601,12 +1386,13 @@ struct splay_tree {
     clear();
   }
 
-  splay_tree_node<Value>* find(const Key& key) {
+  node_type* find(const Key& key) {
     auto* const tree = this;
-    auto node = find_candidate(tree->root, key, tree->extractor, tree->comparator);
+    auto navigator = key_navigator<Key, KeyExtractor, KeyComparator>{
+      key, tree->extractor, tree->comparator};
+    tree->root = SplayPolicy::splay(tree->root, navigator);
+    auto node = tree->root;
     if (node != nullptr) {
-      splay_node(node);
-      tree->root = node;
       const auto strictly_less = tree->comparator(tree->extractor(node->value), key);
       const auto strictly_greater = tree->comparator(key, tree->extractor(node->value));
       if (strictly_less || strictly_greater) {
@@ -616,31 +1402,116 @@ struct splay_tree {
     return node;
   }
 
-  // insert value `value` into the tree `tree` and rebalance the tree
-  splay_tree_node<Value>* insert(const Value& value) {
+  // find node with key `key` without splaying, the tree is only read
+  const node_type* find_const(const Key& key) const {
+    const auto* const tree = this;
+    auto node = link_target(tree->root);
+    while (node != nullptr) {
+      if (tree->comparator(key, tree->extractor(node->value))) {
+        node = link_target(node->left);
+      } else if (tree->comparator(tree->extractor(node->value), key)) {
+        node = link_target(node->right);
+      } else {
+        break;
+      }
+    }
+    return node;
+  }
+
+  // aggregate of the values with keys in the range [low, high] without splaying,
+  // the tree is only read
+  total_type aggregate_const(const Key& low, const Key& high) const {
+    const auto* const tree = this;
+    return aggregate_range(
+      link_target(tree->root), low, high, tree->extractor, tree->comparator);
+  }
+
+  // aggregate of the values with keys in the range [low, high]. The boundary of `low`
+  // is splayed to the root, so that the range is the root and a prefix of its right
+  // subtree, and the prefix is summed along the path of `high`. The boundary of `high`
+  // is splayed then to pay for that path
+  total_type aggregate(const Key& low, const Key& high) {
     auto* const tree = this;
-    auto node = static_cast<splay_tree_node<Value>*>(nullptr);
     if (tree->root == nullptr) {
-      auto new_node = create_node(value);
-      tree->root = new_node;
-      new_node->parent = nullptr;
-      node = new_node;
-    } else {
-      node = insert_node<Key, Value, KeyExtractor, KeyComparator>(
-        tree->root, value, tree->extractor, tree->comparator);
-      if (node != nullptr) {
-        splay_node(node);
-        tree->root = node;
+      return aggregate_type::identity();
+    }
+    auto low_navigator = key_navigator<Key, KeyExtractor, KeyComparator>{
+      low, tree->extractor, tree->comparator};
+    tree->root = SplayPolicy::splay(tree->root, low_navigator);
+    // the root is the predecessor or the successor of `low`, keys in the left subtree
+    // are less than `low` in both cases
+    const auto root = link_target(tree->root);
+    auto total = aggregate_type::identity();
+    if (!tree->comparator(tree->extractor(root->value), low)) {
+      if (tree->comparator(high, tree->extractor(root->value))) {
+        return total;
       }
+      total = aggregate_type::of(root->value);
+    }
+    const auto right_total = aggregate_prefix(
+      link_target(root->right), high, tree->extractor, tree->comparator);
+    total = aggregate_type::combine(total, right_total);
+    auto high_navigator = key_navigator<Key, KeyExtractor, KeyComparator>{
+      high, tree->extractor, tree->comparator};
+    tree->root = SplayPolicy::splay(tree->root, high_navigator);
+    return total;
+  }
+
+  // insert value `value` into the tree `tree` and rebalance the tree. The key of
+  // `value` is splayed first, the root is then its predecessor or its successor and
+  // the new node goes above it, taking over the root's subtree on its own side.
+  // Returns nullptr if the key is already in the tree
+  node_type* insert(const Value& value) {
+    auto* const tree = this;
+    if (tree->root == nullptr) {
+      auto node = create_node(value, tree->allocator);
+      node->parent = nullptr;
+      tree->root = node;
+      return node;
+    }
+    const auto& key = tree->extractor(value);
+    auto navigator = key_navigator<Key, KeyExtractor, KeyComparator>{
+      key, tree->extractor, tree->comparator};
+    const auto root = SplayPolicy::splay(tree->root, navigator);
+    tree->root = root;
+    const auto is_left_of_root = tree->comparator(key, tree->extractor(root->value));
+    if (!is_left_of_root && !tree->comparator(tree->extractor(root->value), key)) {
+      return nullptr;
+    }
+    auto node = create_node(value, tree->allocator);
+    if (is_left_of_root) {
+      node->left = root->left;
+      root->left = nullptr;
+      node->right = root;
+    } else {
+      node->right = root->right;
+      root->right = nullptr;
+      node->left = root;
+    }
+    if (node->left != nullptr) {
+      node->left->parent = node;
+    }
+    if (node->right != nullptr) {
+      node->right->parent = node;
     }
+    node->parent = nullptr;
+    update_total(root);
+    update_total(node);
+    tree->root = node;
     return node;
   }
 
-  // erase node `node` from tree `tree`
-  splay_tree_node<Value>* erase(splay_tree_node<Value>* node) {
+
+  // erase node `node` from tree `tree`. The node is splayed by its key, the maximum of
+  // its left subtree is splayed then to join the subtrees
+  node_type* erase(node_type* node) {
     auto* const tree = this;
-    splay_node(node);
-    const auto left = node->left;
+    const auto& key = tree->extractor(node->value);
+    auto navigator = key_navigator<Key, KeyExtractor, KeyComparator>{
+      key, tree->extractor, tree->comparator};
+    tree->root = SplayPolicy::splay(tree->root, navigator);
+    assert(tree->root == node);
+    auto left = node->left;
     if (node->left != nullptr) {
       node->left->parent = nullptr;
     }
@@ -648,18 +1519,21 @@ struct splay_tree {
     if (node->right != nullptr) {
       node->right->parent = nullptr;
     }
-    destroy_node(node);
-    tree->root = merge_subtrees(left, right);
+    destroy_node(node, tree->allocator);
+    if (left != nullptr) {
+      left = SplayPolicy::splay(left, rightmost_navigator{});
+    }
+    tree->root = merge_subtrees<Value, links_type, aggregate_type>(left, right);
     return right;
   }
 
   void split_lower(
       const Value& value,
-      splay_tree<Key, Value, KeyExtractor, KeyComparator>& left_tree,
-      splay_tree<Key, Value, KeyExtractor, KeyComparator>& right_tree) {
+      self& left_tree,
+      self& right_tree) {
     auto* const tree = this;
     auto trees = split_lower_impl(
-      tree->root, tree->extractor(value), tree->extractor, tree->comparator);
+      tree->root, tree->extractor(value), tree->extractor, tree->comparator, SplayPolicy{});
     tree->root = nullptr;
     left_tree.clear();
     left_tree.root = trees.first;
@@ -669,11 +1543,11 @@ struct splay_tree {
 
   void split_upper(
       const Value& value,
-      splay_tree<Key, Value, KeyExtractor, KeyComparator>& left_tree,
-      splay_tree<Key, Value, KeyExtractor, KeyComparator>& right_tree) {
+      self& left_tree,
+      self& right_tree) {
     auto* const tree = this;
     auto trees = split_upper_impl(
-      tree->root, tree->extractor(value), tree->extractor, tree->comparator);
+      tree->root, tree->extractor(value), tree->extractor, tree->comparator, SplayPolicy{});
     tree->root = nullptr;
     left_tree.clear();
     left_tree.root = trees.first;
@@ -681,41 +1555,72 @@ struct splay_tree {
     right_tree.root = trees.second;
   }
 
-  void merge(splay_tree<Key, Value, KeyExtractor, KeyComparator>& rhs) {
+  void merge(self& rhs) {
     auto* const lhs = this;
+    if (lhs->root != nullptr && rhs.root != nullptr) {
+      // the maximum of `lhs` at the root makes the merge trivial
+      lhs->root = SplayPolicy::splay(lhs->root, rightmost_navigator{});
+    }
     lhs->root = merge_subtrees(lhs->root, rhs.root);
     rhs.root = nullptr;
   }
 
-  void swap(splay_tree<Key, Value, KeyExtractor, KeyComparator>& other) {
+  void swap(self& other) {
     auto* const tree = this;
     std::swap(tree->root, other.root);
+    std::swap(tree->allocator, other.allocator);
   }
 
   void clear() {
     auto* const tree = this;
-    destroy_substree(tree->root);
+    destroy_substree(tree->root, tree->allocator);
+    tree->root = nullptr;
+  }
+
+  // forget all nodes without destroying them, for allocators which free all the nodes
+  // at once
+  void release() noexcept {
+    auto* const tree = this;
+    tree->root = nullptr;
   }
 
-  splay_tree_node<Value>* root;
+  node_type* root;
   KeyExtractor extractor;
   KeyComparator comparator;
+  NodeAllocator allocator;
 };
 
-template <typename Key, typename Value, typename KeyExtractor, typename KeyComparator>
+template <
+  typename Key, typename Value, typename KeyExtractor, typename KeyComparator,
+  typename NodeAllocator, typename SplayPolicy>
 std::ostream& operator << (
-    std::ostream& out, const splay_tree<Key, Value, KeyExtractor, KeyComparator>& tree) {
+    std::ostream& out,
+    const splay_tree<Key, Value, KeyExtractor, KeyComparator, NodeAllocator, SplayPolicy>& tree) {
   print_subtree(out, tree.root);
   return out;
 }
 
-template <typename T>
-class fast_range_summator {
+// Ordered set of numbers which answers aggregate queries over the numbers in a range,
+// the aggregate is given by the monoid `Aggregate`
+template <typename T, typename Aggregate>
+class range_aggregate_index {
  public:
-  fast_range_summator()
-    : tree{}
+  using total_type = typename Aggregate::value_type;
+
+  range_aggregate_index()
+    : pool{}
+    , tree{key_comparator{}, node_allocator{&pool}}
   {}
 
+  range_aggregate_index(const range_aggregate_index&) = delete;
+  range_aggregate_index& operator = (const range_aggregate_index&) = delete;
+
+  ~range_aggregate_index() {
+    // all nodes live in the pool, drop them in one go
+    tree.release();
+    pool.reset();
+  }
+
   void add(const T& number) {
     tree.insert(number);
   }
@@ -732,19 +1637,21 @@ class fast_range_summator {
     return (node != nullptr);
   }
 
-  T sum(const T& low, const T& high) {
+  // same as `contains`, but the tree is not splayed, so concurrent calls are safe
+  bool contains_const(const T& number) const {
+    return tree.find_const(number) != nullptr;
+  }
+
+  // aggregate of the numbers in the range [low, high]
+  total_type aggregate(const T& low, const T& high) {
     assert(low <= high);
-    auto left_tree = tree_type{};
-    auto middle_tree = tree_type{};
-    auto right_tree = tree_type{};
-    auto middle_right_tree = tree_type{};
-    tree.split_lower(low, left_tree, middle_right_tree);
-    middle_right_tree.split_upper(high, middle_tree, right_tree);
-    const auto total = (middle_tree.root != nullptr ? middle_tree.root->total : T{});
-    middle_tree.merge(right_tree);
-    left_tree.merge(middle_tree);
-    tree.swap(left_tree);
-    return total;
+    return tree.aggregate(low, high);
+  }
+
+  // same as `aggregate`, but the tree is not splayed, so concurrent calls are safe
+  total_type aggregate_const(const T& low, const T& high) const {
+    assert(low <= high);
+    return tree.aggregate_const(low, high);
   }
 
  private:
@@ -763,20 +1670,299 @@ class fast_range_summator {
     }
   };
 
-  using tree_type = splay_tree<T, T, default_key_extractor<T>, default_key_comparator<T>>;
+  using node_type = splay_tree_node<T, pointer_links, Aggregate>;
+  using key_extractor = default_key_extractor<T>;
+  using key_comparator = default_key_comparator<T>;
+  using node_allocator = pool_node_allocator<node_type>;
+  using splay_policy = top_down_splay;
+  using tree_type = splay_tree<
+    T, T, key_extractor, key_comparator, node_allocator, splay_policy>;
 
+  node_pool<node_type> pool;
   tree_type tree;
   const bool debug = true;
 };
 
+template <typename T>
+class fast_range_summator : public range_aggregate_index<T, sum_aggregate<T>> {
+ public:
+  T sum(const T& low, const T& high) {
+    return this->aggregate(low, high);
+  }
+
+  T sum_const(const T& low, const T& high) const {
+    return this->aggregate_const(low, high);
+  }
+};
+
+// Range aggregate index shared between threads: any number of readers query the index
+// at the same time, a writer waits for them and updates it alone. Reads do not splay,
+// so the tree is not adapted to the queries
+template <typename T, typename Aggregate>
+class shared_range_aggregate_index {
+ public:
+  using total_type = typename Aggregate::value_type;
+
+  void add(const T& number) {
+    auto lock = std::unique_lock<std::shared_mutex>{mutex};
+    index.add(number);
+  }
+
+  void remove(const T& number) {
+    auto lock = std::unique_lock<std::shared_mutex>{mutex};
+    index.remove(number);
+  }
+
+  bool contains(const T& number) const {
+    auto lock = std::shared_lock<std::shared_mutex>{mutex};
+    return index.contains_const(number);
+  }
+
+  total_type aggregate(const T& low, const T& high) const {
+    auto lock = std::shared_lock<std::shared_mutex>{mutex};
+    return index.aggregate_const(low, high);
+  }
+
+ private:
+  range_aggregate_index<T, Aggregate> index;
+  mutable std::shared_mutex mutex;
+};
+
+// Node of the persistent treap. Nodes are immutable once built and are shared
+// between the versions of the tree, an update copies the nodes on the search path only.
+// Invariants:
+// 1. keys are ordered as in `splay_tree_node`
+// 2. priority of a node is not less than priorities of its children
+template <typename Value, typename Aggregate = sum_aggregate<Value>>
+struct persistent_tree_node {
+  using link_type = std::shared_ptr<const persistent_tree_node<Value, Aggregate>>;
+  using aggregate_type = Aggregate;
+  using total_type = typename Aggregate::value_type;
+
+  persistent_tree_node(const Value& value, uint32_t priority, link_type left, link_type right)
+    : value{value}
+    , priority{priority}
+    , total{Aggregate::combine(
+        Aggregate::combine(
+          left != nullptr ? left->total : Aggregate::identity(), Aggregate::of(value)),
+        right != nullptr ? right->total : Aggregate::identity())}
+    , left{std::move(left)}
+    , right{std::move(right)}
+  {}
+
+  Value value;
+  uint32_t priority;
+  // aggregate of the values in the subtree
+  total_type total;
+  link_type left;
+  link_type right;
+};
+
+// copy of the node `node` with children `left` and `right`
+template <typename Value, typename Aggregate>
+typename persistent_tree_node<Value, Aggregate>::link_type rebuild_persistent_node(
+    const persistent_tree_node<Value, Aggregate>& node,
+    typename persistent_tree_node<Value, Aggregate>::link_type left,
+    typename persistent_tree_node<Value, Aggregate>::link_type right) {
+  return std::make_shared<const persistent_tree_node<Value, Aggregate>>(
+    node.value, node.priority, std::move(left), std::move(right));
+}
+
+// merge two persistent subtrees `lhs` and `rhs`, nodes of both are kept intact
+// all keys in subtree of `lhs` must be strictly less then any key in subtree of `rhs`
+template <typename Value, typename Aggregate>
+typename persistent_tree_node<Value, Aggregate>::link_type merge_persistent_subtrees(
+    const typename persistent_tree_node<Value, Aggregate>::link_type& lhs,
+    const typename persistent_tree_node<Value, Aggregate>::link_type& rhs) {
+  if (lhs == nullptr) {
+    return rhs;
+  }
+  if (rhs == nullptr) {
+    return lhs;
+  }
+  if (lhs->priority >= rhs->priority) {
+    return rebuild_persistent_node(
+      *lhs, lhs->left, merge_persistent_subtrees<Value, Aggregate>(lhs->right, rhs));
+  }
+  return rebuild_persistent_node(
+    *rhs, merge_persistent_subtrees<Value, Aggregate>(lhs, rhs->left), rhs->right);
+}
+
+// split persistent subtree `root` onto two trees `left` and `right` such that
+// any key in `left` is less than `key` (less than or equal to `key` if `inclusive`)
+// any key in `right` is greater or equal to `key` (greater than `key` if `inclusive`)
+template <typename Key, typename Value, typename Aggregate, typename KeyExtractor,
+          typename KeyComparator>
+std::pair<
+  typename persistent_tree_node<Value, Aggregate>::link_type,
+  typename persistent_tree_node<Value, Aggregate>::link_type>
+split_persistent_subtree(
+    const typename persistent_tree_node<Value, Aggregate>::link_type& root,
+    const Key& key,
+    bool inclusive,
+    const KeyExtractor& extractor,
+    const KeyComparator& comparator) {
+  using link_type = typename persistent_tree_node<Value, Aggregate>::link_type;
+  if (root == nullptr) {
+    return std::make_pair(link_type{}, link_type{});
+  }
+  const auto goes_left = inclusive
+    ? !comparator(key, extractor(root->value))
+    : comparator(extractor(root->value), key);
+  if (goes_left) {
+    auto split = split_persistent_subtree<Key, Value, Aggregate>(
+      root->right, key, inclusive, extractor, comparator);
+    return std::make_pair(
+      rebuild_persistent_node(*root, root->left, std::move(split.first)),
+      std::move(split.second));
+  }
+  auto split = split_persistent_subtree<Key, Value, Aggregate>(
+    root->left, key, inclusive, extractor, comparator);
+  return std::make_pair(
+    std::move(split.first),
+    rebuild_persistent_node(*root, std::move(split.second), root->right));
+}
+
+// Persistent treap with the interface of `splay_tree`. Copying the tree is O(1) and
+// gives an independent version: both versions share all the nodes, an update of one
+// version copies O(log n) nodes and never changes the other version. Reads do not
+// modify the tree, so any number of threads may read versions which nobody updates
+template <typename Key, typename Value, typename KeyExtractor, typename KeyComparator,
+          typename Aggregate = sum_aggregate<Value>>
+struct persistent_tree {
+  using node_type = persistent_tree_node<Value, Aggregate>;
+  using link_type = typename node_type::link_type;
+  using total_type = typename node_type::total_type;
+
+  explicit persistent_tree(const KeyComparator& comparator = KeyComparator{})
+    : root{}
+    , extractor{}
+    , comparator{comparator}
+    , generator{}
+  {}
+
+  const node_type* find(const Key& key) const {
+    const auto* const tree = this;
+    auto node = link_target(tree->root);
+    while (node != nullptr) {
+      if (tree->comparator(key, tree->extractor(node->value))) {
+        node = link_target(node->left);
+      } else if (tree->comparator(tree->extractor(node->value), key)) {
+        node = link_target(node->right);
+      } else {
+        break;
+      }
+    }
+    return node;
+  }
+
+  // insert value `value` unless its key is in the tree already
+  bool insert(const Value& value) {
+    auto* const tree = this;
+    const auto& key = tree->extractor(value);
+    if (tree->find(key) != nullptr) {
+      return false;
+    }
+    auto split = split_persistent_subtree<Key, Value, Aggregate>(
+      tree->root, key, false, tree->extractor, tree->comparator);
+    auto node = std::make_shared<const node_type>(
+      value, static_cast<uint32_t>(tree->generator()), link_type{}, link_type{});
+    tree->root = merge_persistent_subtrees<Value, Aggregate>(
+      merge_persistent_subtrees<Value, Aggregate>(split.first, node), split.second);
+    return true;
+  }
+
+  // erase value with key `key`
+  bool erase(const Key& key) {
+    auto* const tree = this;
+    if (tree->find(key) == nullptr) {
+      return false;
+    }
+    auto lower = split_persistent_subtree<Key, Value, Aggregate>(
+      tree->root, key, false, tree->extractor, tree->comparator);
+    auto upper = split_persistent_subtree<Key, Value, Aggregate>(
+      lower.second, key, true, tree->extractor, tree->comparator);
+    tree->root = merge_persistent_subtrees<Value, Aggregate>(lower.first, upper.second);
+    return true;
+  }
+
+  total_type aggregate(const Key& low, const Key& high) const {
+    const auto* const tree = this;
+    return aggregate_range(
+      link_target(tree->root), low, high, tree->extractor, tree->comparator);
+  }
+
+  void clear() {
+    auto* const tree = this;
+    tree->root = nullptr;
+  }
+
+  link_type root;
+  KeyExtractor extractor;
+  KeyComparator comparator;
+  std::minstd_rand generator;
+};
+
+template <typename T, typename Aggregate>
+class persistent_range_aggregate_index {
+ public:
+  using total_type = typename Aggregate::value_type;
+
+  void add(const T& number) {
+    tree.insert(number);
+  }
+
+  void remove(const T& number) {
+    tree.erase(number);
+  }
+
+  bool contains(const T& number) const {
+    return tree.find(number) != nullptr;
+  }
+
+  // aggregate of the numbers in the range [low, high]
+  total_type aggregate(const T& low, const T& high) const {
+    assert(low <= high);
+    return tree.aggregate(low, high);
+  }
+
+  // version of the index as it is now, unaffected by the later updates of this one
+  persistent_range_aggregate_index snapshot() const {
+    return *this;
+  }
+
+ private:
+
+  template <typename Key>
+  struct default_key_extractor {
+    const Key& operator () (const Key& t) const {
+      return t;
+    }
+  };
+
+  template <typename Key>
+  struct default_key_comparator {
+    bool operator ()(const Key& lhs, const Key& rhs) const {
+      return lhs < rhs;
+    }
+  };
+
+  using tree_type = persistent_tree<
+    T, T, default_key_extractor<T>, default_key_comparator<T>, Aggregate>;
+
+  tree_type tree;
+};
+
 class request_value_generator {
  public:
   request_value_generator(int64_t seed = 0)
     : seed{seed}
   {}
 
+  static constexpr auto modulus = int64_t{1000000001};
+
   int64_t get(int64_t value) {
-    return (value + this->seed) % 1000000001;
+    return (value + this->seed) % modulus;
   }
 
   void set_seed(int64_t seed) {
@@ -796,76 +1982,135 @@ enum class summator_request_type : uint8_t {
 
 struct summator_request {
   summator_request_type type;
-  std::vector<int64_t> params;
+  int64_t params[2];
 };
 
-std::vector<summator_request> read_requests(std::istream& in) {
-  auto requests_count = size_t{0};
-  in >> requests_count;
-  auto requests = std::vector<summator_request>{};
-  requests.reserve(requests_count);
-  for (auto request_id = size_t{0}; request_id < requests_count; ++request_id) {
-    auto command = std::string{};
+size_t params_count(summator_request_type type) {
+  return type == summator_request_type::sum ? size_t{2} : size_t{1};
+}
+
+// Requests come as text or in the binary format. The binary format is the marker
+// byte, the requests count as uint64_t and the requests, every request is the type
+// byte followed by its int64_t params. Numbers are in the byte order of the machine
+constexpr auto binary_requests_marker = 0xB1;
+
+// Stream of requests, every request is parsed only when it is asked for
+class summator_request_reader {
+ public:
+  explicit summator_request_reader(input_scanner& in)
+    : in{in}
+    , requests_left{0}
+    , binary{in.next_byte() == binary_requests_marker}
+  {
+    if (binary) {
+      auto marker = uint8_t{0};
+      auto count = uint64_t{0};
+      in.read_binary(marker).read_binary(count);
+      requests_left = count;
+    } else {
+      in >> requests_left;
+    }
+  }
+
+  // number of requests which are not read yet
+  size_t size() const {
+    return requests_left;
+  }
+
+  // parse next request into `request`, false when the requests are over
+  bool next(summator_request& request) {
+    if (requests_left == 0) {
+      return false;
+    }
+    --requests_left;
+    if (binary) {
+      in.read_binary(request.type);
+      for (auto param_id = size_t{0}; param_id < params_count(request.type); ++param_id) {
+        in.read_binary(request.params[param_id]);
+      }
+      return true;
+    }
+    auto command = char{};
     in >> command;
-    auto request = summator_request{summator_request_type::add, std::vector<int64_t>{}};
-    if (command == "+") {
-      auto value = int64_t{0};
-      in >> value;
+    if (command == '+') {
       request.type = summator_request_type::add;
-      request.params.push_back(value);
-    } else if (command == "-") {
-      auto value = int64_t{0};
-      in >> value;
+    } else if (command == '-') {
       request.type = summator_request_type::remove;
-      request.params.push_back(value);
-    } else if (command == "?") {
-      auto value = int64_t{0};
-      in >> value;
+    } else if (command == '?') {
       request.type = summator_request_type::find;
-      request.params.push_back(value);
-    } else if (command == "s") {
-      auto left = int64_t{0};
-      in >> left;
-      auto right = int64_t{0};
-      in >> right;
+    } else if (command == 's') {
       request.type = summator_request_type::sum;
-      request.params.push_back(left);
-      request.params.push_back(right);
     } else {
       assert(false);
     }
-    requests.emplace_back(request);
+    for (auto param_id = size_t{0}; param_id < params_count(request.type); ++param_id) {
+      in >> request.params[param_id];
+    }
+    return true;
+  }
+
+ private:
+  input_scanner& in;
+  size_t requests_left;
+  bool binary;
+};
+
+// convert requests to the binary format
+void encode_requests(summator_request_reader& reader, output_printer& out) {
+  out.write_binary(static_cast<uint8_t>(binary_requests_marker));
+  out.write_binary(static_cast<uint64_t>(reader.size()));
+  auto request = summator_request{};
+  while (reader.next(request)) {
+    out.write_binary(request.type);
+    for (auto param_id = size_t{0}; param_id < params_count(request.type); ++param_id) {
+      out.write_binary(request.params[param_id]);
+    }
   }
-  return requests;
 }
 
-int main() {
+// seed of the request values which follow the answer `total` to a range request,
+// kept below the modulus of the values
+template <
+  typename Integer,
+  typename std::enable_if<std::is_integral<Integer>::value, int>::type = 0>
+int64_t seed_of(Integer total) {
+  const auto modulus = static_cast<uint64_t>(request_value_generator::modulus);
+  return static_cast<int64_t>(static_cast<uint64_t>(total) % modulus);
+}
+
+int64_t seed_of(const polynomial_hash& total) {
+  return seed_of(total.hash);
+}
+
+// serve the requests with `index`, range requests are answered with the aggregate
+// of the index over the range
+template <typename Index>
+void serve_requests(summator_request_reader& reader, Index& index, output_printer& out) {
   auto generator = request_value_generator{};
-  auto summator = fast_range_summator<int64_t>{};
-  auto requests = read_requests(std::cin);
-  for (const auto& request : requests) {
+  auto request = summator_request{};
+  while (reader.next(request)) {
     switch (request.type) {
       case summator_request_type::add: {
-        summator.add(generator.get(request.params[0]));
+        index.add(generator.get(request.params[0]));
         break;
       }
       case summator_request_type::remove: {
-        summator.remove(generator.get(request.params[0]));
+        index.remove(generator.get(request.params[0]));
         break;
       }
       case summator_request_type::find: {
-        if (summator.contains(generator.get(request.params[0]))) {
-          std::cout << "Found\n";
+        if (index.contains(generator.get(request.params[0]))) {
+          out << "Found\n";
         } else {
-          std::cout << "Not found\n";
+          out << "Not found\n";
         }
         break;
       }
       case summator_request_type::sum: {
-        const auto total = summator.sum(
+        const auto total = index.aggregate(
           generator.get(request.params[0]), generator.get(request.params[1]));
-        std::cout << total << '\n';
-        generator.set_seed(total);
+        out << total << '\n';
+        generator.set_seed(seed_of(total));
         break;
       }
       default : {
@@ -874,5 +2119,68 @@ int main() {
       }
     }
   }
+}
+
+// serve the requests with the index of the aggregate `name`, false if there is no
+// aggregate with this name
+bool serve_aggregate_requests(
+    const std::string& name, summator_request_reader& reader, output_printer& out) {
+  if (name == "sum") {
+    auto index = fast_range_summator<int64_t>{};
+    serve_requests(reader, index, out);
+  } else if (name == "sum_of_squares") {
+    auto index = range_aggregate_index<int64_t, sum_of_squares_aggregate<int64_t>>{};
+    serve_requests(reader, index, out);
+  } else if (name == "count") {
+    auto index = range_aggregate_index<int64_t, count_aggregate<int64_t>>{};
+    serve_requests(reader, index, out);
+  } else if (name == "min") {
+    auto index = range_aggregate_index<int64_t, min_aggregate<int64_t>>{};
+    serve_requests(reader, index, out);
+  } else if (name == "max") {
+    auto index = range_aggregate_index<int64_t, max_aggregate<int64_t>>{};
+    serve_requests(reader, index, out);
+  } else if (name == "hash") {
+    auto index = range_aggregate_index<int64_t, polynomial_hash_aggregate<int64_t>>{};
+    serve_requests(reader, index, out);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// `--encode` converts the requests to the binary format, `--aggregate <name>` answers
+// range requests with the aggregate `name` (sum, sum_of_squares, count, min, max or
+// hash) instead of the sum, `--persistent` and `--shared` serve the requests with the
+// persistent and with the shared index
+int main(int argc, char* argv[]) {
+  auto input = input_scanner{stdin};
+  auto output = output_printer{stdout};
+  auto reader = summator_request_reader{input};
+  const auto option = argc > 1 ? std::string{argv[1]} : std::string{};
+  if (option == "--encode") {
+    encode_requests(reader, output);
+    return 0;
+  }
+  if (option == "--aggregate") {
+    const auto name = argc > 2 ? std::string{argv[2]} : std::string{};
+    if (!serve_aggregate_requests(name, reader, output)) {
+      std::cerr << "unknown aggregate '" << name << "'\n";
+      return 1;
+    }
+    return 0;
+  }
+  if (option == "--persistent") {
+    auto index = persistent_range_aggregate_index<int64_t, sum_aggregate<int64_t>>{};
+    serve_requests(reader, index, output);
+    return 0;
+  }
+  if (option == "--shared") {
+    auto index = shared_range_aggregate_index<int64_t, sum_aggregate<int64_t>>{};
+    serve_requests(reader, index, output);
+    return 0;
+  }
+  auto summator = fast_range_summator<int64_t>{};
+  serve_requests(reader, summator, output);
   return 0;
-}
\ No newline at end of file
+}
@@ -1,18 +1,248 @@
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+// Reader of whitespace separated tokens. The input is read in large blocks and
+// the tokens are parsed straight from the block, bypassing the iostream machinery
+class input_scanner {
+ public:
+  explicit input_scanner(std::FILE* file, size_t block_size = size_t{1} << 16)
+    : file_{file}
+    , block_(block_size)
+    , position_{0}
+    , size_{0}
+  {}
+
+  template <
+    typename Integer,
+    typename std::enable_if<std::is_integral<Integer>::value, int>::type = 0>
+  input_scanner& operator >> (Integer& value) {
+    skip_spaces();
+    const auto negative = (peek() == '-');
+    if (negative) {
+      ++position_;
+    }
+    auto result = Integer{0};
+    for (auto c = peek(); '0' <= c && c <= '9'; c = peek()) {
+      result = static_cast<Integer>(result * 10 + (c - '0'));
+      ++position_;
+    }
+    value = negative ? static_cast<Integer>(-result) : result;
+    return *this;
+  }
+
+  input_scanner& operator >> (char& value) {
+    skip_spaces();
+    const auto c = peek();
+    if (c != end_of_input) {
+      value = static_cast<char>(c);
+      ++position_;
+    }
+    return *this;
+  }
+
+  input_scanner& operator >> (std::string& value) {
+    skip_spaces();
+    value.clear();
+    while (peek() != end_of_input) {
+      auto last = position_;
+      while (last < size_ && !is_space(static_cast<unsigned char>(block_[last]))) {
+        ++last;
+      }
+      value.append(block_.data() + position_, last - position_);
+      position_ = last;
+      if (position_ < size_) {
+        break;
+      }
+    }
+    return *this;
+  }
+
+ private:
+  static constexpr int end_of_input = -1;
+
+  static bool is_space(int c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+  }
+
+  int peek() {
+    if (position_ == size_) {
+      size_ = std::fread(block_.data(), 1, block_.size(), file_);
+      position_ = 0;
+      if (size_ == 0) {
+        return end_of_input;
+      }
+    }
+    return static_cast<unsigned char>(block_[position_]);
+  }
+
+  void skip_spaces() {
+    while (is_space(peek())) {
+      ++position_;
+    }
+  }
+
+  std::FILE* file_;
+  std::vector<char> block_;
+  size_t position_;
+  size_t size_;
+};
+
+// Writer of text output. The text is gathered in a large block which is written out
+// when it is full, on `flush` and on destruction. Integers are formatted by hand
+class output_printer {
+ public:
+  explicit output_printer(std::FILE* file, size_t block_size = size_t{1} << 16)
+    : file_{file}
+    , block_(block_size)
+    , size_{0}
+  {}
+
+  output_printer(const output_printer&) = delete;
+  output_printer& operator = (const output_printer&) = delete;
+
+  ~output_printer() {
+    flush();
+  }
+
+  template <
+    typename Integer,
+    typename std::enable_if<std::is_integral<Integer>::value, int>::type = 0>
+  output_printer& operator << (Integer value) {
+    using unsigned_type = typename std::make_unsigned<Integer>::type;
+    // room for the sign and all the digits
+    reserve(std::numeric_limits<unsigned_type>::digits10 + 2);
+    auto magnitude = static_cast<unsigned_type>(value);
+    if (value < Integer{0}) {
+      block_[size_++] = '-';
+      magnitude = unsigned_type{0} - magnitude;
+    }
+    char digits[std::numeric_limits<unsigned_type>::digits10 + 1];
+    auto count = size_t{0};
+    do {
+      digits[count++] = static_cast<char>('0' + magnitude % 10);
+      magnitude /= 10;
+    } while (magnitude != 0);
+    while (count > 0) {
+      block_[size_++] = digits[--count];
+    }
+    return *this;
+  }
+
+  output_printer& operator << (char value) {
+    reserve(1);
+    block_[size_++] = value;
+    return *this;
+  }
+
+  output_printer& operator << (const char* text) {
+    write(text, std::strlen(text));
+    return *this;
+  }
+
+  output_printer& operator << (const std::string& text) {
+    write(text.data(), text.size());
+    return *this;
+  }
+
+  // write out everything printed so far
+  void flush() {
+    drain();
+    std::fflush(file_);
+  }
+
+ private:
+  void drain() {
+    std::fwrite(block_.data(), 1, size_, file_);
+    size_ = 0;
+  }
+
+  void reserve(size_t count) {
+    if (block_.size() - size_ < count) {
+      drain();
+    }
+  }
+
+  void write(const char* data, size_t count) {
+    reserve(count);
+    if (count > block_.size()) {
+      std::fwrite(data, 1, count, file_);
+      return;
+    }
+    std::memcpy(block_.data() + size_, data, count);
+    size_ += count;
+  }
+
+  std::FILE* file_;
+  std::vector<char> block_;
+  size_t size_;
+};
+
+template <typename Node>
+class index_node_pool;
+
+// Link which addresses a node by its 32-bit index in the `index_node_pool`
+// of the node type. Behaves like a pointer to the node
+template <typename Node>
+class index_link {
+ public:
+  index_link(Node* node = nullptr) noexcept
+    : index_{index_node_pool<Node>::index_of(node)}
+  {}
+
+  operator Node* () const noexcept {
+    return index_node_pool<Node>::node_at(index_);
+  }
+
+  Node* operator -> () const noexcept {
+    return index_node_pool<Node>::node_at(index_);
+  }
+
+ private:
+  uint32_t index_;
+};
+
+// Nodes are linked by raw pointers
+struct pointer_links {
+  template <typename Node>
+  using link = Node*;
+  using size_type = uint64_t;
+};
+
+// Nodes are linked by 32-bit indices, nodes must be allocated from `index_node_pool`
+struct index_links {
+  template <typename Node>
+  using link = index_link<Node>;
+  using size_type = uint32_t;
+};
+
 // Node of the splay tree
 // Invariants:
 // 1. any key in the left subtree is strictly less than value
 // 2. any key in the right subtree is strictly greater than value
 // 3. no duplicate keys
 
-template <typename Value>
+template <typename Value, typename Links = pointer_links>
 struct tree_node {
+  using links_type = Links;
+  using link_type = typename Links::template link<tree_node<Value, Links>>;
+  using size_type = typename Links::size_type;
 
   tree_node(const Value& value) noexcept
     : value{value}
+    , tag{}
+    , reversed{false}
+    , assigned{false}
     , size{1}
     , parent{nullptr}
     , left{nullptr}
@@ -24,7 +254,9 @@ struct tree_node {
     node->parent = nullptr;
     node->left = nullptr;
     node->right = nullptr;
-    node->size = uint64_t{0};
+    node->reversed = false;
+    node->assigned = false;
+    node->size = size_type{0};
   }
 
   bool is_root() const noexcept {
@@ -42,7 +274,7 @@ struct tree_node {
     return !node->is_root() && node->parent->right == node;
   }
 
-  const tree_node<Value>* find_root() const noexcept {
+  const tree_node<Value, Links>* find_root() const noexcept {
     const auto* node = this;
     if (node == nullptr) {
       return nullptr;
@@ -53,7 +285,7 @@ struct tree_node {
     return node;
   }
 
-  const tree_node<Value>* rightmost_node() const noexcept {
+  const tree_node<Value, Links>* rightmost_node() const noexcept {
     const auto* node = this;
     while (node->right != nullptr) {
       node = node->right;
@@ -61,12 +293,12 @@ struct tree_node {
     return node;
   }
 
-  tree_node<Value>* rightmost_node() noexcept {
+  tree_node<Value, Links>* rightmost_node() noexcept {
     const auto* const node = this;
-    return const_cast<tree_node<Value>*>(node->rightmost_node());
+    return const_cast<tree_node<Value, Links>*>(node->rightmost_node());
   }
 
-  const tree_node<Value>* leftmost_node() const noexcept {
+  const tree_node<Value, Links>* leftmost_node() const noexcept {
     const auto* node = this;
     while (node->left != nullptr) {
       node = node->left;
@@ -74,15 +306,15 @@ struct tree_node {
     return node;
   }
 
-  tree_node<Value>* leftmost_node() noexcept {
+  tree_node<Value, Links>* leftmost_node() noexcept {
     const auto* const node = this;
-    return const_cast<tree_node<Value>*>(node->leftmost_node());
+    return const_cast<tree_node<Value, Links>*>(node->leftmost_node());
   }
 
   // find next node with respect to key order
-  const tree_node<Value>* next_node() const noexcept {
+  const tree_node<Value, Links>* next_node() const noexcept {
     const auto* node = this;
-    auto next = static_cast<const tree_node<Value>*>(nullptr);
+    auto next = static_cast<const tree_node<Value, Links>*>(nullptr);
     if (node->right != nullptr) {
       next = node->right;
       while (next->left != nullptr) {
@@ -97,15 +329,15 @@ struct tree_node {
     return next;
   }
 
-  tree_node<Value>* next_node() noexcept {
+  tree_node<Value, Links>* next_node() noexcept {
     const auto* const node = this;
-    return const_cast<tree_node<Value>*>(node->next_node());
+    return const_cast<tree_node<Value, Links>*>(node->next_node());
   }
 
   // find previous node with respect to key order
-  const tree_node<Value>* prev_node() const {
+  const tree_node<Value, Links>* prev_node() const {
     const auto* node = this;
-    auto prev = static_cast<const tree_node<Value>*>(nullptr);
+    auto prev = static_cast<const tree_node<Value, Links>*>(nullptr);
     if (node->left != nullptr) {
       prev = node->left;
       while (prev->right != nullptr) {
@@ -120,66 +352,302 @@ struct tree_node {
     return prev;
   }
 
-  tree_node<Value>* prev_node() noexcept {
+  tree_node<Value, Links>* prev_node() noexcept {
     const auto* const node = this;
-    return const_cast<tree_node<Value>*>(node->prev_node());
+    return const_cast<tree_node<Value, Links>*>(node->prev_node());
   }
 
   Value value;
-  uint64_t size;
-  tree_node<Value>* parent;
-  tree_node<Value>* left;
-  tree_node<Value>* right;
+  // pending update of the children, already applied to the node itself: the value
+  // added to the subtrees, or the value assigned to them if `assigned` is set
+  Value tag;
+  // the children subtrees are to be reversed
+  bool reversed;
+  bool assigned;
+  size_type size;
+  link_type parent;
+  link_type left;
+  link_type right;
 };
 
-template <typename Value>
-void print_node(std::ostream& out, const tree_node<Value>& node) {
+template <typename Value, typename Links>
+void print_node(std::ostream& out, const tree_node<Value, Links>& node) {
   out << "[v=" << node.value << ", s=" << node.size << "]";
 }
 
-template <typename Value>
-std::ostream& operator << (std::ostream& out, const tree_node<Value>& node) {
+template <typename Value, typename Links>
+std::ostream& operator << (std::ostream& out, const tree_node<Value, Links>& node) {
   print_node(out, node);
   return out;
 }
 
-template <typename Value>
-void destroy_node(tree_node<Value>* node) noexcept {
+// Node allocator which takes every node from the global heap
+template <typename Node>
+struct heap_node_allocator {
+  using node_type = Node;
+
+  template <typename... Args>
+  Node* create(Args&&... args) {
+    return new Node(std::forward<Args>(args)...);
+  }
+
+  void destroy(Node* node) noexcept {
+    delete node;
+  }
+};
+
+// Storage of nodes of the same type. Nodes are carved out of contiguous slabs,
+// destroyed nodes are kept in the free list and reused by the next allocations.
+// All slabs are released at once by `reset` or by the destructor, nodes which are
+// still alive at that moment are dropped without running their destructors
+template <typename Node>
+class node_pool {
+ public:
+  explicit node_pool(size_t slab_size = size_t{1024})
+    : slabs_{}
+    , slab_size_{slab_size}
+    , used_{slab_size}
+    , free_list_{nullptr}
+  {
+    assert(slab_size_ > 0);
+  }
+
+  node_pool(const node_pool&) = delete;
+  node_pool& operator = (const node_pool&) = delete;
+
+  template <typename... Args>
+  Node* create(Args&&... args) {
+    auto place = static_cast<void*>(nullptr);
+    if (free_list_ != nullptr) {
+      place = free_list_;
+      free_list_ = free_list_->next;
+    } else {
+      if (used_ == slab_size_) {
+        grow();
+      }
+      place = std::addressof(slabs_.back()[used_]);
+      ++used_;
+    }
+    return ::new (place) Node(std::forward<Args>(args)...);
+  }
+
+  void destroy(Node* node) noexcept {
+    assert(node != nullptr);
+    node->~Node();
+    auto cell = ::new (static_cast<void*>(node)) free_cell;
+    cell->next = free_list_;
+    free_list_ = cell;
+  }
+
+  // release all slabs at once
+  void reset() noexcept {
+    slabs_.clear();
+    used_ = slab_size_;
+    free_list_ = nullptr;
+  }
+
+ private:
+  using cell = typename std::aligned_storage<sizeof(Node), alignof(Node)>::type;
+
+  struct free_cell {
+    free_cell* next;
+  };
+
+  static_assert(sizeof(free_cell) <= sizeof(Node), "node is too small for the free list");
+
+  void grow() {
+    // slabs double in size so that the number of slabs stays logarithmic
+    if (!slabs_.empty()) {
+      slab_size_ *= 2;
+    }
+    slabs_.emplace_back(new cell[slab_size_]);
+    used_ = size_t{0};
+  }
+
+  std::vector<std::unique_ptr<cell[]>> slabs_;
+  size_t slab_size_;
+  size_t used_;
+  free_cell* free_list_;
+};
+
+// Node allocator which takes nodes from the shared `node_pool`. Trees which exchange
+// nodes (split, merge) must use the same pool
+template <typename Node>
+struct pool_node_allocator {
+  using node_type = Node;
+
+  explicit pool_node_allocator(node_pool<Node>* pool = nullptr) noexcept
+    : pool{pool}
+  {}
+
+  template <typename... Args>
+  Node* create(Args&&... args) {
+    assert(pool != nullptr);
+    return pool->create(std::forward<Args>(args)...);
+  }
+
+  void destroy(Node* node) noexcept {
+    assert(pool != nullptr);
+    pool->destroy(node);
+  }
+
+  node_pool<Node>* pool;
+};
+
+// Storage of nodes addressed by 32-bit indices. Nodes live in a single array
+// reserved up front for `capacity` nodes, so that the addresses are stable and
+// an index is computed from the address of the node. Index 0 stands for null.
+// Links of the node type are resolved through the static base of the array,
+// so only one pool per node type may exist at a time. A second pool would redirect
+// the links of the first one and running out of capacity would write past the array,
+// so both stop the program in any build
+template <typename Node>
+class index_node_pool {
+ public:
+  explicit index_node_pool(size_t capacity)
+    : cells_{}
+    , capacity_{capacity}
+    , used_{1}
+    , free_list_{0}
+  {
+    check(
+      capacity_ < size_t{std::numeric_limits<uint32_t>::max()},
+      "capacity exceeds 32-bit indices");
+    check(base_ == nullptr, "another pool of the node type is alive");
+    cells_.reset(new cell[capacity + 1]);
+    base_ = cells_.get();
+  }
+
+  index_node_pool(const index_node_pool&) = delete;
+  index_node_pool& operator = (const index_node_pool&) = delete;
+
+  ~index_node_pool() {
+    base_ = nullptr;
+  }
+
+  template <typename... Args>
+  Node* create(Args&&... args) {
+    auto index = uint32_t{0};
+    if (free_list_ != 0) {
+      index = free_list_;
+      free_list_ = *reinterpret_cast<uint32_t*>(std::addressof(cells_[index]));
+    } else {
+      check(used_ <= capacity_, "out of capacity");
+      index = static_cast<uint32_t>(used_);
+      ++used_;
+    }
+    return ::new (static_cast<void*>(std::addressof(cells_[index])))
+      Node(std::forward<Args>(args)...);
+  }
+
+  void destroy(Node* node) noexcept {
+    assert(node != nullptr);
+    const auto index = index_of(node);
+    node->~Node();
+    ::new (static_cast<void*>(node)) uint32_t{free_list_};
+    free_list_ = index;
+  }
+
+  // release all nodes at once, the storage is kept for reuse
+  void reset() noexcept {
+    used_ = size_t{1};
+    free_list_ = uint32_t{0};
+  }
+
+  static Node* node_at(uint32_t index) noexcept {
+    return index != 0 ? reinterpret_cast<Node*>(std::addressof(base_[index])) : nullptr;
+  }
+
+  static uint32_t index_of(const Node* node) noexcept {
+    return node != nullptr
+      ? static_cast<uint32_t>(reinterpret_cast<const cell*>(node) - base_)
+      : uint32_t{0};
+  }
+
+ private:
+  using cell = typename std::aligned_storage<sizeof(Node), alignof(Node)>::type;
+
+  static_assert(sizeof(uint32_t) <= sizeof(Node), "node is too small for the free list");
+
+  static void check(bool condition, const char* message) noexcept {
+    if (!condition) {
+      std::fprintf(stderr, "index_node_pool: %s\n", message);
+      std::abort();
+    }
+  }
+
+  static cell* base_;
+
+  std::unique_ptr<cell[]> cells_;
+  size_t capacity_;
+  size_t used_;
+  uint32_t free_list_;
+};
+
+template <typename Node>
+typename index_node_pool<Node>::cell* index_node_pool<Node>::base_ = nullptr;
+
+// Node allocator which takes nodes from the `index_node_pool`, the only allocator
+// suitable for nodes with `index_links`
+template <typename Node>
+struct index_node_allocator {
+  using node_type = Node;
+
+  explicit index_node_allocator(index_node_pool<Node>* pool = nullptr) noexcept
+    : pool{pool}
+  {}
+
+  template <typename... Args>
+  Node* create(Args&&... args) {
+    assert(pool != nullptr);
+    return pool->create(std::forward<Args>(args)...);
+  }
+
+  void destroy(Node* node) noexcept {
+    assert(pool != nullptr);
+    pool->destroy(node);
+  }
+
+  index_node_pool<Node>* pool;
+};
+
+template <typename Value, typename Links, typename NodeAllocator>
+void destroy_node(tree_node<Value, Links>* node, NodeAllocator& allocator) noexcept {
   assert(node != nullptr);
-  delete node;
+  allocator.destroy(node);
 }
 
-template <typename Value>
-tree_node<Value>* create_node(const Value& value) {
-  return new tree_node<Value>(value);
+template <typename Value, typename NodeAllocator>
+typename NodeAllocator::node_type* create_node(const Value& value, NodeAllocator& allocator) {
+  return allocator.create(value);
 }
 
-template <typename Value>
-void print_subtree(std::ostream& out, const tree_node<Value>* root) {
+template <typename Value, typename Links>
+void print_subtree(std::ostream& out, const tree_node<Value, Links>* root) {
   out << "(";
   if (root != nullptr) {
-    print_subtree(out, root->left);
+    print_subtree<Value, Links>(out, root->left);
     print_node(out, *root);
-    print_subtree(out, root->right);
+    print_subtree<Value, Links>(out, root->right);
   }
   out << ")";
 }
 
-template <typename Value>
-void destroy_substree(tree_node<Value>* root) noexcept {
+template <typename Value, typename Links, typename NodeAllocator>
+void destroy_substree(tree_node<Value, Links>* root, NodeAllocator& allocator) noexcept {
   if (root == nullptr) {
     return;
   }
-  destroy_substree(root->left);
+  destroy_substree<Value, Links>(root->left, allocator);
   root->left = nullptr;
-  destroy_substree(root->right);
+  destroy_substree<Value, Links>(root->right, allocator);
   root->right = nullptr;
   root->parent = nullptr;
-  destroy_node(root);
+  destroy_node(root, allocator);
 }
 
-template <typename Value>
-void update_size(tree_node<Value>* node) noexcept {
+template <typename Value, typename Links>
+void update_size(tree_node<Value, Links>* node) noexcept {
   if (node != nullptr) {
     node->size = uint64_t{1};
     node->size += (node->left != nullptr ? node->left->size : uint64_t{0});
@@ -187,20 +655,77 @@ void update_size(tree_node<Value>* node) noexcept {
   }
 }
 
+// Range updates are lazy: an update of a whole subtree is applied to its root only
+// and is kept in the root's tags until the tags are pushed down to the children.
+// Tags are pushed down before the descent goes below a node and before a node takes
+// part in a rotation. Walks along parent links (`next_node`, `prev_node`) see the
+// actual order only if there are no pending tags above
+
+// reverse the order of nodes in the subtree under `root`
+template <typename Value, typename Links>
+void reverse_subtree(tree_node<Value, Links>* root) noexcept {
+  if (root != nullptr) {
+    std::swap(root->left, root->right);
+    root->reversed = !root->reversed;
+  }
+}
+
+// add `delta` to every value in the subtree under `root`
+template <typename Value, typename Links>
+void add_subtree(tree_node<Value, Links>* root, const Value& delta) noexcept {
+  if (root != nullptr) {
+    root->value = static_cast<Value>(root->value + delta);
+    root->tag = static_cast<Value>(root->tag + delta);
+  }
+}
+
+// assign `value` to every value in the subtree under `root`
+template <typename Value, typename Links>
+void assign_subtree(tree_node<Value, Links>* root, const Value& value) noexcept {
+  if (root != nullptr) {
+    root->value = value;
+    root->tag = value;
+    root->assigned = true;
+  }
+}
+
+// push pending updates of the node `node` down to its children
+template <typename Value, typename Links>
+void push_down_node(tree_node<Value, Links>* node) noexcept {
+  if (node->reversed) {
+    reverse_subtree<Value, Links>(node->left);
+    reverse_subtree<Value, Links>(node->right);
+    node->reversed = false;
+  }
+  if (node->assigned) {
+    assign_subtree<Value, Links>(node->left, node->tag);
+    assign_subtree<Value, Links>(node->right, node->tag);
+    node->assigned = false;
+    node->tag = Value{};
+  } else if (node->tag != Value{}) {
+    add_subtree<Value, Links>(node->left, node->tag);
+    add_subtree<Value, Links>(node->right, node->tag);
+    node->tag = Value{};
+  }
+}
+
 // insert value to subtree at root `root`, no rebalancing
-template <typename Key, typename Value, typename KeyComparator, typename KeyExtractor>
-tree_node<Value>* insert_subtree(
-    tree_node<Value>* root,
+template <
+  typename Key, typename Value, typename Links, typename KeyComparator, typename KeyExtractor,
+  typename NodeAllocator>
+tree_node<Value, Links>* insert_subtree(
+    tree_node<Value, Links>* root,
     const Value& value,
     const KeyComparator& comparator,
-    const KeyExtractor& extractor) {
+    const KeyExtractor& extractor,
+    NodeAllocator& allocator) {
   assert(root != nullptr);
-  auto node = static_cast<tree_node<Value>*>(nullptr);
+  auto node = static_cast<tree_node<Value, Links>*>(nullptr);
   while (root != nullptr) {
     node = root;
     if (comparator(extractor(value), extractor(root->value))) {
       if (root->left == nullptr) {
-        auto new_node = create_node(value);
+        auto new_node = create_node(value, allocator);
         root->left = new_node;
         new_node->parent = root;
         node = new_node;
@@ -210,7 +735,7 @@ tree_node<Value>* insert_subtree(
       }
     } else if (comparator(extractor(root->value), extractor(value))) {
       if (root->right == nullptr) {
-        auto new_node = create_node(value);
+        auto new_node = create_node(value, allocator);
         root->right = new_node;
         new_node->parent = root;
         node = new_node;
@@ -233,8 +758,8 @@ tree_node<Value>* insert_subtree(
   return node;
 }
 
-template <typename Value>
-void left_rotate_node(tree_node<Value>* node) noexcept {
+template <typename Value, typename Links>
+void left_rotate_node(tree_node<Value, Links>* node) noexcept {
   /* u is node, a is parent, B is branch, p is granny
   *
   *      p             p
@@ -248,9 +773,9 @@ void left_rotate_node(tree_node<Value>* node) noexcept {
 
   assert(node != nullptr);
   assert(node->parent != nullptr);
-  auto parent = node->parent;
-  auto branch = node->right;
-  auto granny = parent->parent;
+  auto parent = static_cast<tree_node<Value, Links>*>(node->parent);
+  auto branch = static_cast<tree_node<Value, Links>*>(node->right);
+  auto granny = static_cast<tree_node<Value, Links>*>(parent->parent);
   if (granny != nullptr) {
     if (parent->is_left_child()) {
       granny->left = node;
@@ -271,8 +796,8 @@ void left_rotate_node(tree_node<Value>* node) noexcept {
   update_size(node);
 }
 
-template <typename Value>
-void right_rotate_node(tree_node<Value>* node) noexcept {
+template <typename Value, typename Links>
+void right_rotate_node(tree_node<Value, Links>* node) noexcept {
   /* u is node, a is parent, B is branch, p is granny
   *
   *      p             p
@@ -286,9 +811,9 @@ void right_rotate_node(tree_node<Value>* node) noexcept {
 
   assert(node != nullptr);
   assert(node->parent != nullptr);
-  auto parent = node->parent;
-  auto branch = node->left;
-  auto granny = parent->parent;
+  auto parent = static_cast<tree_node<Value, Links>*>(node->parent);
+  auto branch = static_cast<tree_node<Value, Links>*>(node->left);
+  auto granny = static_cast<tree_node<Value, Links>*>(parent->parent);
   if (granny != nullptr) {
     if (parent->is_left_child()) {
       granny->left = node;
@@ -309,8 +834,8 @@ void right_rotate_node(tree_node<Value>* node) noexcept {
   update_size(node);
 }
 
-template <typename Value>
-void rotate_node(tree_node<Value>* node) noexcept {
+template <typename Value, typename Links>
+void rotate_node(tree_node<Value, Links>* node) noexcept {
   if (node->is_left_child()) {
     left_rotate_node(node);
   } else if (node->is_right_child()) {
@@ -321,8 +846,8 @@ void rotate_node(tree_node<Value>* node) noexcept {
 }
 
 // splay node `node`
-template <typename Value>
-void splay_node(tree_node<Value>* node) noexcept {
+template <typename Value, typename Links>
+void splay_node(tree_node<Value, Links>* node) noexcept {
   /* ------------------------------------------------------------------------------------
   * zig_zig
   *        p                                                                p
@@ -371,6 +896,13 @@ void splay_node(tree_node<Value>* node) noexcept {
   */
   assert(node != nullptr);
   while (node->parent != nullptr) {
+    // the rotated nodes must not have pending updates, tags above them are fine
+    // since rotations keep the set of nodes of the subtree
+    if (!node->parent->is_root()) {
+      push_down_node<Value, Links>(node->parent->parent);
+    }
+    push_down_node<Value, Links>(node->parent);
+    push_down_node(node);
     if (node->parent->is_root()) {
       rotate_node(node);
     } else {
@@ -380,22 +912,25 @@ void splay_node(tree_node<Value>* node) noexcept {
         rotate_node(node);
         rotate_node(node);
       } else {
-        rotate_node(node->parent);
+        rotate_node<Value, Links>(node->parent);
         rotate_node(node);
       }
     }
   }
+  // the node could be the root from the start
+  push_down_node(node);
 }
 
 // find node with key `key` in the subtree under node `root`. If such node doesn't exist
 // return the last node during this search
-template <typename Key, typename Value, typename KeyComparator, typename KeyExtractor>
-const tree_node<Value>* find_candidate_subtree(
-    const tree_node<Value>* root,
+template <
+  typename Key, typename Value, typename Links, typename KeyComparator, typename KeyExtractor>
+const tree_node<Value, Links>* find_candidate_subtree(
+    const tree_node<Value, Links>* root,
     const Key& key,
     const KeyComparator& comparator,
     const KeyExtractor& extractor) noexcept {
-  auto node = static_cast<const tree_node<Value>*>(nullptr);
+  auto node = static_cast<const tree_node<Value, Links>*>(nullptr);
   if (root != nullptr) {
     node = root->parent;
     while (root != nullptr) {
@@ -413,53 +948,57 @@ const tree_node<Value>* find_candidate_subtree(
   return node;
 }
 
-template <typename Key, typename Value, typename KeyComparator, typename KeyExtractor>
-tree_node<Value>* find_candidate_subtree(
-    tree_node<Value>* root,
+template <
+  typename Key, typename Value, typename Links, typename KeyComparator, typename KeyExtractor>
+tree_node<Value, Links>* find_candidate_subtree(
+    tree_node<Value, Links>* root,
     const Key& key,
     const KeyComparator& comparator,
     const KeyExtractor& extractor) noexcept {
   const auto* const node = root;
-  return const_cast<tree_node<Value>*>(find_candidate_subtree(node, key, comparator, extractor));
+  return const_cast<tree_node<Value, Links>*>(
+    find_candidate_subtree(node, key, comparator, extractor));
 }
 
 // find `n` the element (0-based indexing) with respect to keys order in the subtree of
 // the node `root`
-template <typename Value>
-const tree_node<Value>* order_statistic_subtree(
-  const tree_node<Value>* root, size_t n) noexcept {
+// the subtree is not modified, pending reversals are taken into account on the way down
+template <typename Value, typename Links>
+const tree_node<Value, Links>* order_statistic_subtree(
+  const tree_node<Value, Links>* root, size_t n) noexcept {
   auto position = n;
   if (root != nullptr && n >= root->size) {
     return nullptr;
   }
+  auto reversed = false;
   while (root != nullptr) {
-    const auto left_subtree_size = root->left != nullptr ? root->left->size : uint32_t{0};
+    const auto* const left = static_cast<const tree_node<Value, Links>*>(
+      reversed ? root->right : root->left);
+    const auto* const right = static_cast<const tree_node<Value, Links>*>(
+      reversed ? root->left : root->right);
+    const auto left_subtree_size = left != nullptr ? left->size : uint32_t{0};
+    reversed = reversed != root->reversed;
     if (position < left_subtree_size) {
-      root = root->left;
+      root = left;
     } else if (position == left_subtree_size) {
       break;
     } else {
-      root = root->right;
+      root = right;
       position -= left_subtree_size + 1;
     }
   }
   return root;
 }
 
-template <typename Value>
-tree_node<Value>* order_statistic_subtree(tree_node<Value>* root, size_t n) noexcept {
-  const auto* const node = root;
-  return const_cast<tree_node<Value>*>(order_statistic_subtree(node, n));
-}
-
 // return the first node whose key is not less than key
-template <typename Key, typename Value, typename KeyComparator, typename KeyExtractor>
-tree_node<Value>* lower_bound_subtree(
-    tree_node<Value>* root,
+template <
+  typename Key, typename Value, typename Links, typename KeyComparator, typename KeyExtractor>
+tree_node<Value, Links>* lower_bound_subtree(
+    tree_node<Value, Links>* root,
     const Key& key,
     const KeyComparator& comparator,
     const KeyExtractor& extractor) noexcept {
-  auto node = static_cast<tree_node<Value>*>(nullptr);
+  auto node = static_cast<tree_node<Value, Links>*>(nullptr);
   while (root != nullptr) {
     if (!comparator(extractor(root->value), key)) {
       node = root;
@@ -472,13 +1011,14 @@ tree_node<Value>* lower_bound_subtree(
 }
 
 // return the first node whose key is greater than key
-template <typename Key, typename Value, typename KeyComparator, typename KeyExtractor>
-tree_node<Value>* upper_bound_subtree(
-    tree_node<Value>* root,
+template <
+  typename Key, typename Value, typename Links, typename KeyComparator, typename KeyExtractor>
+tree_node<Value, Links>* upper_bound_subtree(
+    tree_node<Value, Links>* root,
     const Key& key,
     const KeyComparator& comparator,
     const KeyExtractor& extractor) noexcept {
-  auto node = static_cast<tree_node<Value>*>(nullptr);
+  auto node = static_cast<tree_node<Value, Links>*>(nullptr);
   while (root != nullptr) {
     if (comparator(key, extractor(root->value))) {
       node = root;
@@ -490,19 +1030,282 @@ tree_node<Value>* upper_bound_subtree(
   return node;
 }
 
-template <typename Value>
-tree_node<Value>* copy_subtree(const tree_node<Value>* root) {
+// Navigators steer the descent from the root: `direction(node)` is negative to go
+// to the left child, positive to go to the right child and zero to stop at `node`.
+// `descend(node, direction)` is called when the descent actually leaves `node`
+
+// navigate to the node with key `key`, or to the last node on the search path
+template <typename Key, typename KeyComparator, typename KeyExtractor>
+struct key_navigator {
+  template <typename Node>
+  int direction(const Node* node) const noexcept {
+    if (comparator(key, extractor(node->value))) {
+      return -1;
+    } else if (comparator(extractor(node->value), key)) {
+      return 1;
+    }
+    return 0;
+  }
+
+  template <typename Node>
+  void descend(const Node*, int) noexcept {}
+
+  const Key& key;
+  const KeyComparator& comparator;
+  const KeyExtractor& extractor;
+};
+
+// navigate to the `position`-th node (0-based indexing) of the subtree
+struct order_navigator {
+  template <typename Node>
+  int direction(const Node* node) const noexcept {
+    const auto left_subtree_size = node->left != nullptr ? node->left->size : uint32_t{0};
+    if (position < left_subtree_size) {
+      return -1;
+    } else if (position == left_subtree_size) {
+      return 0;
+    }
+    return 1;
+  }
+
+  template <typename Node>
+  void descend(const Node* node, int direction) noexcept {
+    if (direction > 0) {
+      position -= (node->left != nullptr ? node->left->size : uint32_t{0}) + 1;
+    }
+  }
+
+  size_t position;
+};
+
+// navigate to the leftmost (`Direction` is -1) or to the rightmost (`Direction` is 1) node
+template <int Direction>
+struct edge_navigator {
+  template <typename Node>
+  int direction(const Node*) const noexcept {
+    return Direction;
+  }
+
+  template <typename Node>
+  void descend(const Node*, int) noexcept {}
+};
+
+using leftmost_navigator = edge_navigator<-1>;
+using rightmost_navigator = edge_navigator<1>;
+
+// descend from `root` as `navigator` says, return the last visited node
+// pending updates of the visited nodes are pushed down
+template <typename Value, typename Links, typename Navigator>
+tree_node<Value, Links>* descend_subtree(
+    tree_node<Value, Links>* root, Navigator& navigator) noexcept {
+  auto node = root;
+  while (node != nullptr) {
+    push_down_node(node);
+    const auto direction = navigator.direction(node);
+    auto child = static_cast<tree_node<Value, Links>*>(nullptr);
+    if (direction < 0) {
+      child = node->left;
+    } else if (direction > 0) {
+      child = node->right;
+    }
+    if (child == nullptr) {
+      break;
+    }
+    navigator.descend(node, direction);
+    node = child;
+  }
+  return node;
+}
+
+// find `n` the element (0-based indexing) in the subtree of the node `root`,
+// pending updates on the path are pushed down
+template <typename Value, typename Links>
+tree_node<Value, Links>* order_statistic_subtree(tree_node<Value, Links>* root, size_t n) noexcept {
+  if (root == nullptr || n >= root->size) {
+    return nullptr;
+  }
+  auto navigator = order_navigator{n};
+  return descend_subtree(root, navigator);
+}
+
+// splay the node found by `navigator` in the subtree under `root`, single pass.
+// On the way down the passed nodes are hung onto the left tree (nodes before the
+// found one) and onto the right tree (nodes after it); two steps in the same
+// direction are preceded by a rotation as in zig-zig. At the end the left and the
+// right trees become the subtrees of the found node. Returns the new root
+template <typename Value, typename Links, typename Navigator>
+tree_node<Value, Links>* splay_top_down(
+    tree_node<Value, Links>* root, Navigator& navigator) noexcept {
+  assert(root == nullptr || root->parent == nullptr);
   if (root == nullptr) {
     return nullptr;
   }
-  auto node = create_node(root->value);
+  auto left_root = static_cast<tree_node<Value, Links>*>(nullptr);
+  auto left_max = static_cast<tree_node<Value, Links>*>(nullptr);
+  auto right_root = static_cast<tree_node<Value, Links>*>(nullptr);
+  auto right_min = static_cast<tree_node<Value, Links>*>(nullptr);
+  auto node = root;
+  while (true) {
+    push_down_node(node);
+    const auto direction = navigator.direction(node);
+    if (direction < 0) {
+      auto child = static_cast<tree_node<Value, Links>*>(node->left);
+      if (child == nullptr) {
+        break;
+      }
+      navigator.descend(node, direction);
+      if (child->left != nullptr && navigator.direction(child) < 0) {
+        // zig-zig, rotate `child` over `node`
+        push_down_node(child);
+        navigator.descend(child, -1);
+        node->left = child->right;
+        if (child->right != nullptr) {
+          child->right->parent = node;
+        }
+        child->right = node;
+        node->parent = child;
+        update_size(node);
+        node = child;
+        child = node->left;
+      }
+      // `node` and its right subtree go to the right tree
+      if (right_min != nullptr) {
+        right_min->left = node;
+        node->parent = right_min;
+      } else {
+        right_root = node;
+        node->parent = nullptr;
+      }
+      right_min = node;
+      node = child;
+    } else if (direction > 0) {
+      auto child = static_cast<tree_node<Value, Links>*>(node->right);
+      if (child == nullptr) {
+        break;
+      }
+      navigator.descend(node, direction);
+      if (child->right != nullptr && navigator.direction(child) > 0) {
+        // zag-zag, rotate `child` over `node`
+        push_down_node(child);
+        navigator.descend(child, 1);
+        node->right = child->left;
+        if (child->left != nullptr) {
+          child->left->parent = node;
+        }
+        child->left = node;
+        node->parent = child;
+        update_size(node);
+        node = child;
+        child = node->right;
+      }
+      // `node` and its left subtree go to the left tree
+      if (left_max != nullptr) {
+        left_max->right = node;
+        node->parent = left_max;
+      } else {
+        left_root = node;
+        node->parent = nullptr;
+      }
+      left_max = node;
+      node = child;
+    } else {
+      break;
+    }
+  }
+  if (left_max != nullptr) {
+    left_max->right = node->left;
+    if (node->left != nullptr) {
+      node->left->parent = left_max;
+    }
+    node->left = left_root;
+    left_root->parent = node;
+  }
+  if (right_min != nullptr) {
+    right_min->left = node->right;
+    if (node->right != nullptr) {
+      node->right->parent = right_min;
+    }
+    node->right = right_root;
+    right_root->parent = node;
+  }
+  node->parent = nullptr;
+  // only the inner spines of the left and the right trees got new children
+  for (auto spine = left_max; spine != nullptr && spine != node; spine = spine->parent) {
+    update_size(spine);
+  }
+  for (auto spine = right_min; spine != nullptr && spine != node; spine = spine->parent) {
+    update_size(spine);
+  }
+  update_size(node);
+  return node;
+}
+
+// Splaying strategies, `splay` brings the node found by the navigator to the root
+// and returns it.
+// `bottom_up_splay` descends to the node and rotates it back up along parent links.
+// `top_down_splay` rotates while descending, in a single pass over the path
+struct bottom_up_splay {
+  template <typename Value, typename Links, typename Navigator>
+  static tree_node<Value, Links>* splay(
+      tree_node<Value, Links>* root, Navigator navigator) noexcept {
+    auto node = descend_subtree(root, navigator);
+    if (node != nullptr) {
+      splay_node(node);
+    }
+    return node;
+  }
+};
+
+struct top_down_splay {
+  template <typename Value, typename Links, typename Navigator>
+  static tree_node<Value, Links>* splay(
+      tree_node<Value, Links>* root, Navigator navigator) noexcept {
+    return splay_top_down(root, navigator);
+  }
+};
+
+// build a perfectly balanced subtree out of `count` values starting at `first`,
+// the values keep their order, `first` is advanced past the used values
+template <typename Iter, typename NodeAllocator>
+typename NodeAllocator::node_type* build_subtree(
+    Iter& first, size_t count, NodeAllocator& allocator) {
+  if (count == 0) {
+    return nullptr;
+  }
+  const auto left_count = count / 2;
+  auto left = build_subtree(first, left_count, allocator);
+  auto node = create_node(*first, allocator);
+  ++first;
+  auto right = build_subtree(first, count - left_count - 1, allocator);
+  node->left = left;
+  if (left != nullptr) {
+    left->parent = node;
+  }
+  node->right = right;
+  if (right != nullptr) {
+    right->parent = node;
+  }
+  update_size(node);
+  return node;
+}
+
+template <typename Value, typename Links, typename NodeAllocator>
+tree_node<Value, Links>* copy_subtree(
+    const tree_node<Value, Links>* root, NodeAllocator& allocator) {
+  if (root == nullptr) {
+    return nullptr;
+  }
+  auto node = create_node(root->value, allocator);
   assert(node != nullptr);
   node->size = root->size;
-  node->left = copy_subtree(root->left);
+  node->tag = root->tag;
+  node->reversed = root->reversed;
+  node->assigned = root->assigned;
+  node->left = copy_subtree<Value, Links>(root->left, allocator);
   if (node->left != nullptr) {
     node->left->parent = node;
   }
-  node->right = copy_subtree(root->right);
+  node->right = copy_subtree<Value, Links>(root->right, allocator);
   if (node->right != nullptr) {
     node->right->parent = node;
   }
@@ -511,9 +1314,9 @@ tree_node<Value>* copy_subtree(const tree_node<Value>* root) {
 
 // merge two subtrees under node `lhs` and `rhs`
 // all keys in subtree of `lhs` must be strictly less then any key in subtree of `rhs`
-template <typename Value>
-tree_node<Value>* merge_subtrees(
-    tree_node<Value>* lhs, tree_node<Value>* rhs) noexcept {
+template <typename Value, typename Links>
+tree_node<Value, Links>* merge_subtrees(
+    tree_node<Value, Links>* lhs, tree_node<Value, Links>* rhs) noexcept {
   assert(lhs == nullptr || lhs->parent == nullptr);
   assert(rhs == nullptr || rhs->parent == nullptr);
   if (lhs == nullptr) {
@@ -522,7 +1325,8 @@ tree_node<Value>* merge_subtrees(
   if (rhs == nullptr) {
     return lhs;
   }
-  auto max_lhs = lhs->rightmost_node();
+  auto navigator = rightmost_navigator{};
+  auto max_lhs = descend_subtree(lhs, navigator);
   splay_node(max_lhs);
   assert(max_lhs->right == nullptr);
   max_lhs->right = rhs;
@@ -533,12 +1337,13 @@ tree_node<Value>* merge_subtrees(
 
 // split root node onto two trees `left` and `right` such that
 // root node goes into the left tree
-template <typename Value>
-std::pair<tree_node<Value>*, tree_node<Value>*> split_left_subtree(tree_node<Value>* root) noexcept {
+template <typename Value, typename Links>
+std::pair<tree_node<Value, Links>*, tree_node<Value, Links>*> split_left_subtree(
+    tree_node<Value, Links>* root) noexcept {
   assert(root != nullptr);
   assert(root->parent == nullptr);
-  auto left = static_cast<tree_node<Value>*>(nullptr);
-  auto right = static_cast<tree_node<Value>*>(nullptr);
+  auto left = static_cast<tree_node<Value, Links>*>(nullptr);
+  auto right = static_cast<tree_node<Value, Links>*>(nullptr);
   left = root;
   right = root->right;
   // forget relatives
@@ -553,12 +1358,13 @@ std::pair<tree_node<Value>*, tree_node<Value>*> split_left_subtree(tree_node<Val
 
 // split root node onto two trees `left` and `right` such that
 // root node goes into the right tree
-template <typename Value>
-std::pair<tree_node<Value>*, tree_node<Value>*> split_right_subtree(tree_node<Value>* root) noexcept {
+template <typename Value, typename Links>
+std::pair<tree_node<Value, Links>*, tree_node<Value, Links>*> split_right_subtree(
+    tree_node<Value, Links>* root) noexcept {
   assert(root != nullptr);
   assert(root->parent == nullptr);
-  auto left = static_cast<tree_node<Value>*>(nullptr);
-  auto right = static_cast<tree_node<Value>*>(nullptr);
+  auto left = static_cast<tree_node<Value, Links>*>(nullptr);
+  auto right = static_cast<tree_node<Value, Links>*>(nullptr);
   left = root->left;
   right = root;
   // forget relatives
@@ -571,57 +1377,68 @@ std::pair<tree_node<Value>*, tree_node<Value>*> split_right_subtree(tree_node<Va
   return std::make_pair(left, right);
 }
 
-template <typename Value>
+template <typename Value, typename Links>
 struct splay_tree_base {
-  tree_node<Value>* root;
+  tree_node<Value, Links>* root;
 };
 
-template <typename Value>
-splay_tree_base<Value> create_tree() noexcept {
-  auto tree = splay_tree_base<Value>{};
+template <typename Value, typename Links>
+splay_tree_base<Value, Links> create_tree() noexcept {
+  auto tree = splay_tree_base<Value, Links>{};
   tree.root = nullptr;
   return tree;
 }
 
-template <typename Value>
-splay_tree_base<Value> create_tree(const Value& value) {
-  auto tree = splay_tree_base<Value>{};
-  tree.root = create_node(value);
+template <typename Value, typename Links, typename NodeAllocator>
+splay_tree_base<Value, Links> create_tree(const Value& value, NodeAllocator& allocator) {
+  auto tree = splay_tree_base<Value, Links>{};
+  tree.root = create_node(value, allocator);
   tree.root->parent = nullptr;
   tree.root->left = nullptr;
   tree.root->right = nullptr;
   return tree;
 }
 
-template <typename Value>
-splay_tree_base<Value> copy_tree(const splay_tree_base<Value>& other) {
-  auto tree = create_tree<Value>();
-  tree.root = copy_subtree(other.root);
+template <typename Value, typename Links, typename NodeAllocator>
+splay_tree_base<Value, Links> copy_tree(
+    const splay_tree_base<Value, Links>& other, NodeAllocator& allocator) {
+  auto tree = create_tree<Value, Links>();
+  tree.root = copy_subtree(other.root, allocator);
   return tree;
 }
 
-template <typename Value>
-void swap_trees(splay_tree_base<Value>& lhs, splay_tree_base<Value>& rhs) noexcept {
+// build a balanced tree out of the values in [first, last) in the same order
+template <typename Value, typename Links, typename Iter, typename NodeAllocator>
+splay_tree_base<Value, Links> build_tree(Iter first, Iter last, NodeAllocator& allocator) {
+  auto tree = create_tree<Value, Links>();
+  const auto count = static_cast<size_t>(std::distance(first, last));
+  tree.root = build_subtree(first, count, allocator);
+  return tree;
+}
+
+template <typename Value, typename Links>
+void swap_trees(splay_tree_base<Value, Links>& lhs, splay_tree_base<Value, Links>& rhs) noexcept {
   std::swap(lhs.root, rhs.root);
 }
 
-template <typename Value>
-void clear_tree(splay_tree_base<Value>& tree) noexcept {
-  destroy_substree(tree.root);
+template <typename Value, typename Links, typename NodeAllocator>
+void clear_tree(splay_tree_base<Value, Links>& tree, NodeAllocator& allocator) noexcept {
+  destroy_substree(tree.root, allocator);
+  tree.root = nullptr;
 }
 
-template <typename Value>
-size_t get_size_tree(const splay_tree_base<Value>& tree) noexcept {
+template <typename Value, typename Links>
+size_t get_size_tree(const splay_tree_base<Value, Links>& tree) noexcept {
   return tree.root != nullptr ? tree.root->size : size_t{0};
 }
 
-template <typename Value>
-bool is_empty_tree(const splay_tree_base<Value>& tree) noexcept {
+template <typename Value, typename Links>
+bool is_empty_tree(const splay_tree_base<Value, Links>& tree) noexcept {
   return tree.root == nullptr;
 }
 
-template <typename Value>
-void splay_node_tree(splay_tree_base<Value>& tree, tree_node<Value>* node) noexcept {
+template <typename Value, typename Links>
+void splay_node_tree(splay_tree_base<Value, Links>& tree, tree_node<Value, Links>* node) noexcept {
   assert(node != nullptr);
   assert(node->find_root() == tree.root);
   splay_node(node);
@@ -630,15 +1447,19 @@ void splay_node_tree(splay_tree_base<Value>& tree, tree_node<Value>* node) noexc
 
 // find node with key equal to `key`, if doesn't exist return null
 // rebalances the tree
-template <typename Key, typename Value, typename KeyComparator, typename KeyExtractor>
-tree_node<Value>* find_tree(
-    splay_tree_base<Value>& tree,
+template <
+  typename Key, typename Value, typename Links, typename KeyComparator, typename KeyExtractor,
+  typename SplayPolicy = bottom_up_splay>
+tree_node<Value, Links>* find_tree(
+    splay_tree_base<Value, Links>& tree,
     const Key& key,
     const KeyComparator& comparator,
-    const KeyExtractor& extractor) {
-  auto node = find_candidate_subtree(tree.root, key, comparator, extractor);
+    const KeyExtractor& extractor,
+    const SplayPolicy& policy = SplayPolicy{}) {
+  auto navigator = key_navigator<Key, KeyComparator, KeyExtractor>{key, comparator, extractor};
+  tree.root = policy.splay(tree.root, navigator);
+  auto node = tree.root;
   if (node != nullptr) {
-    splay_node_tree(tree, node);
     const auto strictly_less = comparator(extractor(node->value), key);
     const auto strictly_greater = comparator(key, extractor(node->value));
     if (strictly_less || strictly_greater) {
@@ -648,50 +1469,83 @@ tree_node<Value>* find_tree(
   return node;
 }
 
+// bring the node next to the root of `tree` to the root
+// return null and keep the tree as is if the root is the last node
+template <typename Value, typename Links, typename SplayPolicy>
+tree_node<Value, Links>* splay_next_tree(
+    splay_tree_base<Value, Links>& tree, const SplayPolicy& policy) noexcept {
+  assert(tree.root != nullptr);
+  push_down_node(tree.root);
+  auto right = static_cast<tree_node<Value, Links>*>(tree.root->right);
+  if (right == nullptr) {
+    return nullptr;
+  }
+  right->parent = nullptr;
+  right = policy.splay(right, leftmost_navigator{});
+  tree.root->right = right;
+  right->parent = tree.root;
+  rotate_node(right);
+  tree.root = right;
+  return right;
+}
+
 // find the first node in `tree` with the key not less than `key`
-template <typename Key, typename Value, typename KeyComparator, typename KeyExtractor>
-tree_node<Value>* lower_bound_tree(
-    splay_tree_base<Value>& tree,
+template <
+  typename Key, typename Value, typename Links, typename KeyComparator, typename KeyExtractor,
+  typename SplayPolicy = bottom_up_splay>
+tree_node<Value, Links>* lower_bound_tree(
+    splay_tree_base<Value, Links>& tree,
     const Key& key,
     const KeyComparator& comparator,
-    const KeyExtractor& extractor) {
-  auto bound = lower_bound_subtree(tree.root, key, comparator, extractor);
-  if (bound != nullptr) {
-    splay_node_tree(tree, bound);
+    const KeyExtractor& extractor,
+    const SplayPolicy& policy = SplayPolicy{}) {
+  auto navigator = key_navigator<Key, KeyComparator, KeyExtractor>{key, comparator, extractor};
+  tree.root = policy.splay(tree.root, navigator);
+  auto bound = tree.root;
+  if (bound != nullptr && comparator(extractor(bound->value), key)) {
+    bound = splay_next_tree(tree, policy);
   }
   return bound;
 }
 
 // find the first node in `tree` with the key greater than `key`
-template <typename Key, typename Value, typename KeyComparator, typename KeyExtractor>
-tree_node<Value>* upper_bound_tree(
-    splay_tree_base<Value>& tree,
+template <
+  typename Key, typename Value, typename Links, typename KeyComparator, typename KeyExtractor,
+  typename SplayPolicy = bottom_up_splay>
+tree_node<Value, Links>* upper_bound_tree(
+    splay_tree_base<Value, Links>& tree,
     const Key& key,
     const KeyComparator& comparator,
-    const KeyExtractor& extractor) {
-  auto bound = upper_bound_subtree(tree.root, key, comparator, extractor);
-  if (bound != nullptr) {
-    splay_node_tree(tree, bound);
+    const KeyExtractor& extractor,
+    const SplayPolicy& policy = SplayPolicy{}) {
+  auto navigator = key_navigator<Key, KeyComparator, KeyExtractor>{key, comparator, extractor};
+  tree.root = policy.splay(tree.root, navigator);
+  auto bound = tree.root;
+  if (bound != nullptr && !comparator(key, extractor(bound->value))) {
+    bound = splay_next_tree(tree, policy);
   }
   return bound;
 }
 
 // insert value `value` into the tree `tree` and rebalance the tree
-template <typename Key, typename Value, typename KeyComparator, typename KeyExtractor>
-tree_node<Value>* insert_tree(
-    splay_tree_base<Value>& tree,
+template <
+  typename Key, typename Value, typename Links, typename KeyComparator, typename KeyExtractor,
+  typename NodeAllocator>
+tree_node<Value, Links>* insert_tree(
+    splay_tree_base<Value, Links>& tree,
     const Value& value,
     const KeyComparator& comparator,
-    const KeyExtractor& extractor) {
-  auto node = static_cast<tree_node<Value>*>(nullptr);
+    const KeyExtractor& extractor,
+    NodeAllocator& allocator) {
+  auto node = static_cast<tree_node<Value, Links>*>(nullptr);
   if (tree.root == nullptr) {
-    auto new_node = create_node(value);
+    auto new_node = create_node(value, allocator);
     tree.root = new_node;
     new_node->parent = nullptr;
     node = new_node;
   } else {
-    node = insert_subtree<Key, Value, KeyComparator, KeyExtractor>(
-      tree.root, value, comparator, extractor);
+    node = insert_subtree<Key, Value, Links, KeyComparator, KeyExtractor, NodeAllocator>(
+      tree.root, value, comparator, extractor, allocator);
     if (node != nullptr) {
       splay_node_tree(tree, node);
     }
@@ -700,8 +1554,11 @@ tree_node<Value>* insert_tree(
 }
 
 // erase node `node` from tree `tree`
-template <typename Value>
-tree_node<Value>* erase_tree(splay_tree_base<Value>& tree, tree_node<Value>* node) noexcept {
+template <typename Value, typename Links, typename NodeAllocator>
+tree_node<Value, Links>* erase_tree(
+    splay_tree_base<Value, Links>& tree,
+    tree_node<Value, Links>* node,
+    NodeAllocator& allocator) noexcept {
   assert(node->find_root() == tree.root);
   splay_node_tree(tree, node);
   const auto left = node->left;
@@ -712,8 +1569,8 @@ tree_node<Value>* erase_tree(splay_tree_base<Value>& tree, tree_node<Value>* nod
   if (node->right != nullptr) {
     node->right->parent = nullptr;
   }
-  destroy_node(node);
-  tree.root = merge_subtrees(left, right);
+  destroy_node(node, allocator);
+  tree.root = merge_subtrees<Value, Links>(left, right);
   return right;
 }
 
@@ -722,10 +1579,10 @@ tree_node<Value>* erase_tree(splay_tree_base<Value>& tree, tree_node<Value>* nod
 // the remaining nodes to the left tree
 // if node is null, then all nodes go to the left tree
 // after `tree` contains the left part, the right part is returned
-template <typename Value>
-splay_tree_base<Value> split_left_tree(
-   splay_tree_base<Value>& tree, tree_node<Value>* node) noexcept {
-  auto split = std::pair<tree_node<Value>*, tree_node<Value>*>{};
+template <typename Value, typename Links>
+splay_tree_base<Value, Links> split_left_tree(
+   splay_tree_base<Value, Links>& tree, tree_node<Value, Links>* node) noexcept {
+  auto split = std::pair<tree_node<Value, Links>*, tree_node<Value, Links>*>{};
   if (node != nullptr) {
     assert(node->find_root() == tree.root);
     splay_node_tree(tree, node);
@@ -734,7 +1591,7 @@ splay_tree_base<Value> split_left_tree(
     split = std::make_pair(tree.root, nullptr);
   }
   tree.root = split.first;
-  auto right_tree = create_tree<Value>();
+  auto right_tree = create_tree<Value, Links>();
   right_tree.root = split.second;
   return right_tree;
 }
@@ -744,10 +1601,10 @@ splay_tree_base<Value> split_left_tree(
 // the remaining nodes to the right tree
 // if node is null, then all nodes go to the left tree
 // after `tree` contains the left part, the right part is returned
-template <typename Value>
-splay_tree_base<Value> split_right_tree(
-    splay_tree_base<Value>& tree, tree_node<Value>* node) noexcept {
-  auto split = std::pair<tree_node<Value>*, tree_node<Value>*>{};
+template <typename Value, typename Links>
+splay_tree_base<Value, Links> split_right_tree(
+    splay_tree_base<Value, Links>& tree, tree_node<Value, Links>* node) noexcept {
+  auto split = std::pair<tree_node<Value, Links>*, tree_node<Value, Links>*>{};
   if (node != nullptr) {
     assert(node->find_root() == tree.root);
     splay_node_tree(tree, node);
@@ -756,7 +1613,7 @@ splay_tree_base<Value> split_right_tree(
     split = std::make_pair(tree.root, nullptr);
   }
   tree.root = split.first;
-  auto right_tree = create_tree<Value>();
+  auto right_tree = create_tree<Value, Links>();
   right_tree.root = split.second;
   return right_tree;
 }
@@ -764,59 +1621,77 @@ splay_tree_base<Value> split_right_tree(
 // merge nodes from `rhs` tree into `this` tree.
 // all keys in `rhs` tree must be greater than keys in `this` tree
 // after call `lhs` contains all nodes, `rhs` is empty
-template <typename Value>
-void merge_trees(splay_tree_base<Value>& lhs, splay_tree_base<Value>& rhs) noexcept {
+template <typename Value, typename Links, typename SplayPolicy = bottom_up_splay>
+void merge_trees(
+    splay_tree_base<Value, Links>& lhs,
+    splay_tree_base<Value, Links>& rhs,
+    const SplayPolicy& policy = SplayPolicy{}) noexcept {
+  if (lhs.root != nullptr && rhs.root != nullptr) {
+    // the maximum of `lhs` at the root makes the merge trivial
+    lhs.root = policy.splay(lhs.root, rightmost_navigator{});
+  }
   lhs.root = merge_subtrees(lhs.root, rhs.root);
   rhs.root = nullptr;
 }
 
 // find nth-node (0-based indexing) in the tree with respect to key ordering
 // rebalances the tree
-template <typename Value>
-tree_node<Value>* order_statistic_tree(splay_tree_base<Value>& tree, size_t n) noexcept {
-  auto node = order_statistic_subtree(tree.root, n);
-  if (node != nullptr) {
-    splay_node_tree(tree, node);
+template <typename Value, typename Links, typename SplayPolicy = bottom_up_splay>
+tree_node<Value, Links>* order_statistic_tree(
+    splay_tree_base<Value, Links>& tree,
+    size_t n,
+    const SplayPolicy& policy = SplayPolicy{}) noexcept {
+  if (n >= get_size_tree(tree)) {
+    return nullptr;
   }
-  return node;
+  tree.root = policy.splay(tree.root, order_navigator{n});
+  return tree.root;
 }
 
-template <typename Value>
-void show_tree(std::ostream& out, const splay_tree_base<Value>& tree) {
+template <typename Value, typename Links>
+void show_tree(std::ostream& out, const splay_tree_base<Value, Links>& tree) {
   print_subtree(out, tree.root);
 }
 
 // Splay tree with implicit keys (no duplicate keys)
-template <typename Value>
+// the node layout is chosen by the allocator: `tree_node<Value>` with pointer links
+// or `tree_node<Value, index_links>` together with `index_node_allocator`
+// the splaying strategy is `bottom_up_splay` or `top_down_splay`
+template <
+  typename Value,
+  typename NodeAllocator = heap_node_allocator<tree_node<Value>>,
+  typename SplayPolicy = bottom_up_splay>
 class implicit_splay_tree {
-  using self = implicit_splay_tree<Value>;
-  using node_type = tree_node<Value>;
-  using base_type = splay_tree_base<Value>;
+  using self = implicit_splay_tree<Value, NodeAllocator, SplayPolicy>;
+  using node_type = typename NodeAllocator::node_type;
+  using links_type = typename node_type::links_type;
+  using base_type = splay_tree_base<Value, links_type>;
 
  public:
-  implicit_splay_tree()
-    : impl{create_tree<Value>()}
+  explicit implicit_splay_tree(const NodeAllocator& allocator = NodeAllocator{})
+    : impl{create_tree<Value, links_type>()}
+    , allocator{allocator}
   {}
 
-  implicit_splay_tree(std::initializer_list<Value> init)
-    : implicit_splay_tree{std::begin(init), std::end(init)}
+  implicit_splay_tree(
+      std::initializer_list<Value> init, const NodeAllocator& allocator = NodeAllocator{})
+    : implicit_splay_tree{std::begin(init), std::end(init), allocator}
   {}
 
+  // the tree is built balanced in linear time
   template <typename Iter>
-  implicit_splay_tree(Iter first, Iter last)
-    : implicit_splay_tree{} {
-    for (auto it = first; it != last; ++it) {
-      this->insert(*it);
-    }
+  implicit_splay_tree(Iter first, Iter last, const NodeAllocator& allocator = NodeAllocator{})
+    : implicit_splay_tree{allocator} {
+    this->impl = build_tree<Value, links_type>(first, last, this->allocator);
   }
 
   implicit_splay_tree(const self& other)
-    : implicit_splay_tree{} {
-    this->impl = copy_tree(other.impl);
+    : implicit_splay_tree{other.allocator} {
+    this->impl = copy_tree(other.impl, this->allocator);
   }
 
   implicit_splay_tree(self&& other) noexcept
-    : implicit_splay_tree{} {
+    : implicit_splay_tree{other.allocator} {
     this->swap(other);
   }
 
@@ -834,7 +1709,7 @@ class implicit_splay_tree {
   }
 
   ~implicit_splay_tree() {
-    clear_tree(this->impl);
+    clear_tree(this->impl, this->allocator);
   }
 
   const node_type* root() const noexcept {
@@ -858,56 +1733,104 @@ class implicit_splay_tree {
   }
 
   node_type* insert(const Value& value) {
-    auto new_tree = create_tree<Value>(value);
-    merge_trees(this->impl, new_tree);
+    auto new_tree = create_tree<Value, links_type>(value, this->allocator);
+    merge_trees(this->impl, new_tree, SplayPolicy{});
     return new_tree.root;
   }
 
   // erase node `node` from tree `tree`
   node_type* erase(node_type* node) noexcept {
-    return erase_tree(this->impl, node);
+    return erase_tree(this->impl, node, this->allocator);
   }
 
   self split_left(node_type* node) noexcept {
-    auto right_tree = self{};
+    auto right_tree = self{this->allocator};
     right_tree.impl = split_left_tree(this->impl, node);
     return right_tree;
   }
 
   self split_right(node_type* node) noexcept {
-    auto right_tree = self{};
+    auto right_tree = self{this->allocator};
     right_tree.impl = split_right_tree(this->impl, node);
     return right_tree;
   }
 
   void merge(self& rhs) {
-    merge_trees(this->impl, rhs.impl);
+    merge_trees(this->impl, rhs.impl, SplayPolicy{});
   }
 
   node_type* order_statistic(size_t n) noexcept {
-    return order_statistic_tree(this->impl, n);
+    return order_statistic_tree(this->impl, n, SplayPolicy{});
+  }
+
+  // reverse the order of elements from `begin`-th to `end`-th
+  void reverse(size_t begin, size_t end) noexcept {
+    this->update(begin, end, [](node_type* root) noexcept {
+      reverse_subtree(root);
+    });
+  }
+
+  // add `delta` to elements from `begin`-th to `end`-th
+  void add(size_t begin, size_t end, const Value& delta) noexcept {
+    this->update(begin, end, [&delta](node_type* root) noexcept {
+      add_subtree(root, delta);
+    });
+  }
+
+  // assign `value` to elements from `begin`-th to `end`-th
+  void assign(size_t begin, size_t end, const Value& value) noexcept {
+    this->update(begin, end, [&value](node_type* root) noexcept {
+      assign_subtree(root, value);
+    });
   }
 
   // swap contenrts fof two trees
   void swap(self& other) noexcept {
     auto* const tree = this;
     swap_trees(tree->impl, other.impl);
+    std::swap(tree->allocator, other.allocator);
   }
 
   // remove all nodes from the tree
   void clear() noexcept {
-    clear_tree(this->impl);
+    clear_tree(this->impl, this->allocator);
   }
 
-  template <typename Value_>
-  friend std::ostream& operator << (std::ostream& out, const implicit_splay_tree<Value_>& tree);
+  // forget all nodes without destroying them, for allocators which free all the nodes
+  // at once
+  void release() noexcept {
+    this->impl.root = nullptr;
+  }
+
+  template <typename Value_, typename NodeAllocator_, typename SplayPolicy_>
+  friend std::ostream& operator << (
+      std::ostream& out, const implicit_splay_tree<Value_, NodeAllocator_, SplayPolicy_>& tree);
 
  private:
+  // split off elements from `begin`-th to `end`-th, apply `update` to the root of their
+  // subtree and glue the parts back
+  template <typename Update>
+  void update(size_t begin, size_t end, Update update) noexcept {
+    assert(begin <= end && end < this->size());
+    auto right_tree = this->split_left(this->order_statistic(end));
+    auto middle_tree = self{this->allocator};
+    if (begin > 0) {
+      middle_tree = this->split_left(this->order_statistic(begin - 1));
+    } else {
+      this->swap(middle_tree);
+    }
+    update(middle_tree.root());
+    this->merge(middle_tree);
+    this->merge(right_tree);
+  }
+
   base_type impl;
+  NodeAllocator allocator;
 };
 
-template <typename Value>
-std::ostream& operator << (std::ostream& out, const implicit_splay_tree<Value>& tree) {
+template <typename Value, typename NodeAllocator, typename SplayPolicy>
+std::ostream& operator << (
+    std::ostream& out, const implicit_splay_tree<Value, NodeAllocator, SplayPolicy>& tree) {
   print_tree(out, tree.impl);
   return out;
 }
@@ -916,8 +1839,9 @@ std::ostream& operator << (std::ostream& out, const implicit_splay_tree<Value>&
 // cut subtree starting at `begin`-th element and ending at `end`-th element,
 // the remaining two parts of the tree are glued together
 // the function returns the subtree
-template <typename Value>
-implicit_splay_tree<Value> cut(implicit_splay_tree<Value>& tree, size_t begin, size_t end) {
+template <typename Value, typename NodeAllocator, typename SplayPolicy>
+implicit_splay_tree<Value, NodeAllocator, SplayPolicy> cut(
+    implicit_splay_tree<Value, NodeAllocator, SplayPolicy>& tree, size_t begin, size_t end) {
   assert(begin <= end);
   auto* begin_split_node = tree.order_statistic(begin);
   auto middle_right_tree = tree.split_right(begin_split_node);
@@ -930,9 +1854,11 @@ implicit_splay_tree<Value> cut(implicit_splay_tree<Value>& tree, size_t begin, s
 
 // paste `other` tree inside `tree` before `place`-th element of the `tree`
 // after call middle_tree is empty
-template <typename Value>
+template <typename Value, typename NodeAllocator, typename SplayPolicy>
 void paste(
-    implicit_splay_tree<Value>& tree, implicit_splay_tree<Value>& middle_tree, size_t place) {
+    implicit_splay_tree<Value, NodeAllocator, SplayPolicy>& tree,
+    implicit_splay_tree<Value, NodeAllocator, SplayPolicy>& middle_tree,
+    size_t place) {
   auto split_node = tree.order_statistic(place);
   auto right_tree = tree.split_right(split_node);
   auto& left_tree = tree;
@@ -941,34 +1867,149 @@ void paste(
   assert(middle_tree.empty());
 }
 
-template <typename Value>
-void show_tree(std::ostream& out, const implicit_splay_tree<Value>& tree) {
-  auto node = tree.root()->leftmost_node();
+// move elements from `middle`-th to `last - 1`-th in front of the `first`-th one,
+// that is swap two adjacent blocks [first, middle) and [middle, last).
+// Every part is split off at its last element, which stays at the root with no right
+// child, so splaying the maximum of a part to glue it back ends at once
+template <typename Value, typename NodeAllocator, typename SplayPolicy>
+void swap_blocks(
+    implicit_splay_tree<Value, NodeAllocator, SplayPolicy>& tree,
+    size_t first,
+    size_t middle,
+    size_t last) {
+  assert(first <= middle && middle <= last && last <= tree.size());
+  if (first == middle || middle == last) {
+    return;
+  }
+  auto& head_tree = tree;
+  auto first_middle_tree = first > 0
+    ? head_tree.split_left(head_tree.order_statistic(first - 1))
+    : head_tree.split_right(head_tree.order_statistic(0));
+  auto middle_last_tree = first_middle_tree.split_left(
+    first_middle_tree.order_statistic(middle - first - 1));
+  auto tail_tree = middle_last_tree.split_left(
+    middle_last_tree.order_statistic(last - middle - 1));
+  middle_last_tree.merge(first_middle_tree);
+  head_tree.merge(middle_last_tree);
+  head_tree.merge(tail_tree);
+}
+
+// cut/paste request: cut elements from `begin`-th to `end`-th and paste them before
+// the `place`-th element of the remaining sequence
+struct cut_paste_edit {
+  size_t begin;
+  size_t end;
+  size_t place;
+};
+
+// apply cut/paste edit to `tree` as a swap of two adjacent blocks
+template <typename Value, typename NodeAllocator, typename SplayPolicy>
+void apply_edit(
+    implicit_splay_tree<Value, NodeAllocator, SplayPolicy>& tree, const cut_paste_edit& edit) {
+  assert(edit.begin <= edit.end);
+  const auto length = edit.end - edit.begin + 1;
+  if (edit.place <= edit.begin) {
+    swap_blocks(tree, edit.place, edit.begin, edit.end + 1);
+  } else {
+    swap_blocks(tree, edit.begin, edit.end + 1, edit.place + length);
+  }
+}
+
+// Applier of cut/paste edits to a tree in the order they come, the result is the same
+// as after `cut` and `paste` for every edit. An edit which cuts exactly the block
+// pasted by the previous edit is folded into it, so the last edit is held until the
+// next one or `flush` shows it is complete. Edits which paste the block back to its
+// place are skipped
+template <typename Value, typename NodeAllocator, typename SplayPolicy>
+class cut_paste_editor {
+ public:
+  using tree_type = implicit_splay_tree<Value, NodeAllocator, SplayPolicy>;
+
+  explicit cut_paste_editor(tree_type& tree)
+    : tree_{tree}
+    , pending_{0, 0, 0}
+    , has_pending_{false}
+  {}
+
+  void apply(const cut_paste_edit& edit) {
+    if (has_pending_) {
+      const auto length = pending_.end - pending_.begin + 1;
+      if (edit.begin == pending_.place && edit.end == pending_.place + length - 1) {
+        pending_.place = edit.place;
+        return;
+      }
+      flush();
+    }
+    pending_ = edit;
+    has_pending_ = true;
+  }
+
+  // apply the held edit
+  void flush() {
+    if (has_pending_ && pending_.place != pending_.begin) {
+      apply_edit(tree_, pending_);
+    }
+    has_pending_ = false;
+  }
+
+ private:
+  tree_type& tree_;
+  cut_paste_edit pending_;
+  bool has_pending_;
+};
+
+// go down to the leftmost node of the subtree under `root` pushing pending updates
+template <typename Value, typename Links>
+tree_node<Value, Links>* push_down_leftmost(tree_node<Value, Links>* root) noexcept {
+  auto node = root;
+  push_down_node(node);
+  while (node->left != nullptr) {
+    node = node->left;
+    push_down_node(node);
+  }
+  return node;
+}
+
+// print elements in order, pending updates are pushed down on the way
+template <typename Value, typename NodeAllocator, typename SplayPolicy>
+void show_tree(
+    output_printer& out, implicit_splay_tree<Value, NodeAllocator, SplayPolicy>& tree) {
+  auto node = push_down_leftmost(tree.root());
   while (node != nullptr) {
     out << node->value;
-    node = node->next_node();
+    if (node->right != nullptr) {
+      node = push_down_leftmost<Value, typename NodeAllocator::node_type::links_type>(
+        node->right);
+    } else {
+      node = node->next_node();
+    }
   }
 }
 
 int main() {
+  auto input = input_scanner{stdin};
+  auto output = output_printer{stdout};
   auto text = std::string{};
-  std::cin >> text;
-  using tree_type = implicit_splay_tree<char>;
-  auto tree = tree_type{};
-  for (const auto& symbol : text) {
-    tree.insert(symbol);
-  }
+  input >> text;
+  // the text is the only source of nodes, so the index pool is sized exactly
+  using node_type = tree_node<char, index_links>;
+  using node_allocator = index_node_allocator<node_type>;
+  using tree_type = implicit_splay_tree<char, node_allocator, top_down_splay>;
+  auto pool = index_node_pool<node_type>{text.size()};
+  auto tree = tree_type{std::begin(text), std::end(text), node_allocator{&pool}};
   auto requests_count = size_t{0};
-  std::cin >> requests_count;
+  input >> requests_count;
+  auto editor = cut_paste_editor<char, node_allocator, top_down_splay>{tree};
   for (auto request_id = size_t{0}; request_id < requests_count; ++request_id) {
-    auto begin = size_t{0};
-    std::cin >> begin;
-    auto end = size_t{0};
-    std::cin >> end;
-    auto place = size_t{0};
-    std::cin >> place;
-    auto middle_tree = cut(tree, begin, end);
-    paste(tree, middle_tree, place);
-  }
-  show_tree(std::cout, tree);
+    auto edit = cut_paste_edit{0, 0, 0};
+    input >> edit.begin;
+    input >> edit.end;
+    input >> edit.place;
+    editor.apply(edit);
+  }
+  editor.flush();
+  show_tree(output, tree);
+  // all nodes live in the pool, drop them in one go
+  tree.release();
+  pool.reset();
 }
\ No newline at end of file